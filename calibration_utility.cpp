@@ -13,6 +13,7 @@
 
 #include <Arduino.h>
 #include <math.h>
+#include "sample_stats.h"
 
 #define SENSOR_PIN 34
 #define NUM_SAMPLES 1000
@@ -70,40 +71,23 @@ void computeStatistics() {
     voltage_samples[i] = adc_samples[i] * (ref_voltage / 4095.0);
   }
   
-  // ADC statistics
-  float sum_adc = 0, sum_adc_sq = 0;
-  calib.adc_min = 4095;
-  calib.adc_max = 0;
-  
-  // Voltage statistics
-  float sum_volt = 0, sum_volt_sq = 0;
-  calib.voltage_min = 3.3;
-  calib.voltage_max = 0;
-  
+  // One Welford pass (sample_stats.h, shared with the main sketch): no
+  // cancellation in sum_sq - sum^2 at 12-bit codes
+  SampleStats adc = {0}, volt = {0};
   for (int i = 0; i < NUM_SAMPLES; i++) {
-    // ADC
-    sum_adc += adc_samples[i];
-    sum_adc_sq += adc_samples[i] * adc_samples[i];
-    calib.adc_min = fmin(calib.adc_min, adc_samples[i]);
-    calib.adc_max = fmax(calib.adc_max, adc_samples[i]);
-    
-    // Voltage
-    sum_volt += voltage_samples[i];
-    sum_volt_sq += voltage_samples[i] * voltage_samples[i];
-    calib.voltage_min = fmin(calib.voltage_min, voltage_samples[i]);
-    calib.voltage_max = fmax(calib.voltage_max, voltage_samples[i]);
+    adc.add(i, adc_samples[i]);
+    volt.add(i, voltage_samples[i]);
   }
   
-  calib.adc_mean = sum_adc / NUM_SAMPLES;
-  calib.voltage_mean = sum_volt / NUM_SAMPLES;
-  
-  float adc_var = (sum_adc_sq / NUM_SAMPLES) - (calib.adc_mean * calib.adc_mean);
-  float volt_var = (sum_volt_sq / NUM_SAMPLES) - (calib.voltage_mean * calib.voltage_mean);
-  
-  calib.adc_std = sqrt(amax(adc_var, 0.0));
-  calib.voltage_std = sqrt(fmax(volt_var, 0.0));
-  
-  calib.adc_rms = sqrt(sum_adc_sq / NUM_SAMPLES);
+  calib.adc_min = adc.min_val;
+  calib.adc_max = adc.max_val;
+  calib.voltage_min = volt.min_val;
+  calib.voltage_max = volt.max_val;
+  calib.adc_mean = adc.mean;
+  calib.voltage_mean = volt.mean;
+  calib.adc_std = sqrt(adc.variance());
+  calib.voltage_std = sqrt(volt.variance());
+  calib.adc_rms = sqrt(adc.mean * adc.mean + adc.variance());
   
   // Noise level (high-frequency component)
   float noise_sum = 0;
@@ -18,6 +18,8 @@
 #include <Arduino.h>
 #include <math.h>
 #include <stdint.h>
+#include <stddef.h>
+#include "sample_stats.h"
 
 // ============================================================================
 // SYSTEM CONFIGURATION
@@ -30,6 +32,89 @@
 #define ANOMALY_THRESHOLD 0.6          // Anomaly score threshold (0-1)
 #define FILTER_ALPHA 0.2               // Exponential moving average filter coefficient
 #define UPDATE_INTERVAL_MS 100         // Feature computation interval (10 Hz)
+#define SAMPLE_PERIOD_MS 10            // Nominal (fastest) acquisition period (100 Hz)
+#define NUM_OPERATING_MODES 3          // Max distinct normal operating modes (k)
+#define MODE_LEADER_RADIUS 0.25        // Feature distance (V) that spawns a new mode while learning
+#define MODE_TRACKING_RATE 0.01        // Background baseline drift rate for the matched mode
+#define RESERVOIR_CAPACITY 64          // Feature vectors kept for on-device model fitting
+#define RESERVOIR_RECENCY_FLOOR 0.0    // Min acceptance probability (>0 favours recent vectors)
+#define RESERVOIR_Q_SCALE 8000.0       // Quantization steps per volt (int16 covers +/-4.09 V)
+#define ENABLE_QUANTIZED_SCORING 1     // Score on integer-normalized features after learning
+#define FEATURE_QUANT_BITS 16          // 16 (int16) or 8 (int8) bits per quantized feature
+#define ENABLE_CHANGE_GATE 1           // Reuse the last decision while features provably can't flip it
+#define GATE_MAX_SKIPPED 50            // Force a full evaluation after this many gated cycles
+#define ENABLE_ADAPTIVE_SAMPLING 1     // Slow acquisition down while scores stay calm
+#define SAMPLE_PERIOD_MAX_MS 80        // Slowest acquisition period while calm
+#define RATE_CALM_FRACTION 0.5         // Scores below this fraction of the threshold are calm
+#define RATE_ALERT_FRACTION 0.8        // Scores above this fraction restore the nominal rate
+#define RATE_CALM_DECISIONS 20         // Consecutive calm decisions before the period doubles
+#define RATE_VARIANCE_JUMP 2.0         // std_dev above this multiple of baseline restores the rate
+#define NUM_SHADOW_DETECTORS 2         // Candidate configurations tallied next to the live detector
+#define SHADOW_MATCH_WINDOW_MS 5000    // Max gap between live and shadow onsets of one episode
+#define NOISE_EWMA_ALPHA 0.005         // Noise floor / SNR tracking rate (~200 samples)
+#define NOISE_DEGRADE_RATIO 2.0        // Noise floor above this multiple of learned flags the sensor
+#define NOISE_RECOVER_RATIO 1.5        // ...and below this multiple clears the flag again
+#define NOISE_CLIP_FACTOR 16.0         // Squared differences are clipped at this multiple of the mean
+#define NOISE_HOLD_MAX_MS 30000        // Longest a process anomaly holds the noise floor
+#define ENABLE_NOISE_RETUNE 0          // Lower filter_alpha while the noise floor is raised
+#define ADC_MAX_CODE 4095              // 12-bit ADC full scale
+#define FAULT_STUCK_RUN 25             // Identical consecutive codes that mean a frozen input
+#define FAULT_STUCK_SUSPECT 6          // ...a run this long drops acquisition back to the nominal rate
+#define FAULT_RAIL_RUN 3               // Consecutive codes at 0 or ADC_MAX_CODE that mean a rail fault
+#define FAULT_SLEW_CODES 1024          // Code jump between samples no real signal makes
+#define FAULT_SLEW_HITS 3              // Slew jumps within the last 8 samples that mean a floating input
+#define FAULT_CLEAR_SAMPLES 10         // Clean samples in a row before a fault clears
+#define ENABLE_ADAPTIVE_WINDOW 1       // Shrink the feature window after detected changes
+#define ADAPTIVE_WINDOW_MIN 10         // Shortest effective feature window (samples)
+#define ADWIN_DELTA 0.0001             // Change-test confidence (lower = fewer, surer cuts)
+#define ADWIN_MIN_SHIFT 2.0            // ...and the means must also differ by this many window stds
+#define ADWIN_BUCKETS_PER_LEVEL 2      // Exponential-histogram buckets kept per size class
+#define ENABLE_GAP_FILL 1              // Linearly interpolate short runs of missed samples
+#define GAP_FILL_MAX 5                 // Longest run of missed samples that is interpolated
+#define BLOCK_RUN_MAX 32               // Samples each stage sweeps at once in processBlock()
+#define ENABLE_ROBUST_TREND 0          // Theil-Sen trend (median pairwise slope) instead of least squares
+#define ROBUST_TREND_PAIRS 128         // Pair slopes sampled per window; all pairs if there are fewer
+#define ENABLE_ENVELOPE 1              // Envelope demodulation features (bearing / gear modulation)
+#define ENVELOPE_CENTER_FRACTION 0.25  // Band-pass centre as a fraction of the nominal sample rate
+#define ENVELOPE_Q 2.0                 // Band-pass quality factor (centre / bandwidth)
+#define ENVELOPE_LPF_SHIFT 2           // Envelope low-pass: env += (|x| - env) >> shift
+#define ENVELOPE_DECIMATION 4          // Raw samples per envelope sample
+#define ENVELOPE_BLOCK 32              // Envelope samples per spectrum (power of two)
+#define ENVELOPE_BANDS 4               // Equal-width envelope-spectrum bands exposed as features
+#define ENVELOPE_ALERT_RATIO 4         // Band power above this multiple of learned flags modulation
+#define ENABLE_AR_RESIDUAL 1           // Per-sample AR(p) one-step prediction residual (dynamics changes)
+#define AR_ORDER 4                     // Autoregressive model order p (RLS cost O(p^2) per sample)
+#define AR_FORGETTING 0.995            // RLS forgetting factor (memory ~1 / (1 - factor) samples)
+#define AR_SETTLE_SAMPLES 50           // Samples after a restart before residuals are scored
+#define AR_RESIDUAL_CLIP 25.0          // Cap on one squared normalized residual (a lone spike)
+#define AR_SMOOTHING_SHIFT 5           // Residual level: level += (z^2 - level) / 2^shift
+#define AR_ALERT_RATIO 4.0             // Residual level above this multiple of learned flags dynamics
+#define AR_RESIDUAL_VOTES 0            // A dynamics change flags decisions on its own (else feature only)
+#define RAW_SPIKE_FACTOR 6.0           // Raw sample this many noise floors off the filtered value = spike
+#define RAW_SPIKE_ALERT 3              // Raw spikes in the window that flag a decision on their own
+#define RAW_SPIKE_VOTES 1              // Let RAW_SPIKE_ALERT spikes flag decisions (else feature only)
+#define FAST_MATH_FEATURES 0           // sqrt for std_dev / rms / noise floor via rsqrt + Newton
+#define FAST_MATH_SNR 1                // SNR log10 via log2 table + interpolation
+#define ENABLE_JOURNAL 1               // Keep a decision journal in reset-retained (RTC) RAM
+#define JOURNAL_ENTRIES 64             // Journal ring size (16 bytes per entry)
+#define JOURNAL_HEARTBEAT 100          // Decisions between periodic score entries
+#define JOURNAL_BOOT_PRINT 8           // Newest entries printed when a journal is recovered
+#define SENSOR_TYPE "generic"          // Model family shared by identical sensors (no spaces)
+#define ENABLE_FLEET_PRIOR 1           // Accept a fleet prior blob and merge it into learning
+#define PRIOR_LEARNING_MS 15000        // Learning duration while a fleet prior is loaded
+#define ENABLE_SELF_TEST 1             // "selftest" command: inject a synthetic fault and time its detection
+#define SELF_TEST_BUDGET_MS 2000       // Detection latency a passing self-test must beat
+#define SELF_TEST_MAX_MS 5000          // Longest injection before a self-test gives up
+#define SELF_TEST_STEP_V 0.12          // Step signature: constant offset (~150 codes)
+#define SELF_TEST_SPIKE_V 0.8          // Spike signature: impulse height
+#define SELF_TEST_SPIKE_EVERY 10       // ...on every n-th sample
+#define SELF_TEST_BURST_V 0.1          // Variance burst signature: uniform noise half-range
+#define HIST_SUB_BUCKET_BITS 2         // 2^bits linear sub-buckets per octave (~19% resolution)
+#define HIST_MIN_EXP -16               // Magnitudes below 2^-16 (~15 uV) share the zero bucket
+#define HIST_MAX_EXP 4                 // Magnitudes at or above 2^4 saturate the top bucket
+#define HIST_DUMP_INTERVAL 1000        // Predictions between periodic histogram dumps
+#define CMD_LINE_MAX 48                // Longest accepted serial command line
+#define CMD_POLL_BUDGET_US 200         // Max time per loop() spent reading serial commands
 
 // ============================================================================
 // DATA STRUCTURES
@@ -41,7 +126,12 @@ typedef struct {
   float min_val;
   float max_val;
   float rms;
-  float trend;  // Slope of linear regression
+  float trend;  // Window slope (least squares, or Theil-Sen if ENABLE_ROBUST_TREND)
+  float envelope[ENVELOPE_BANDS];  // Envelope-spectrum band amplitudes (V), low to high
+  float ar_residual;  // Smoothed squared AR one-step residual, 1 = learned dynamics
+  float raw_range;    // Unfiltered max - min over the window (V)
+  float raw_step;     // Largest |step| between consecutive unfiltered samples (V)
+  uint16_t raw_spikes;  // Unfiltered samples RAW_SPIKE_FACTOR noise floors off the filtered value
 } Features_t;
 
 typedef struct {
@@ -57,6 +147,9 @@ typedef struct {
   float filtered_value;
   float raw_value;
   uint32_t timestamp;
+  uint8_t missed;         // interpolated: 1, real: unfilled missed samples before it
+  bool is_interpolated;
+  bool is_spike;          // raw_value far off filtered_value (see appendReading)
   bool is_valid;
 } SensorReading_t;
 
@@ -75,14 +168,149 @@ Features_t current_features = {0};
 uint32_t last_feature_update = 0;
 uint32_t sensor_samples_collected = 0;
 
+// Runtime tunables: defaults from the configuration above, changeable
+// over serial without reflashing (see RUNTIME COMMAND INTERFACE)
+struct {
+  float filter_alpha = FILTER_ALPHA;
+  float anomaly_threshold = ANOMALY_THRESHOLD;
+  uint16_t feature_window = FEATURE_WINDOW;    // <= BUFFER_SIZE
+  uint16_t update_interval_ms = UPDATE_INTERVAL_MS;
+  uint16_t verbosity = 2;                      // 0 = quiet, 1 = decisions, 2 = + diagnostics
+} tunables;
+
 // Performance metrics
 struct {
   uint32_t total_predictions = 0;
   uint32_t anomalies_detected = 0;
+  uint32_t sensor_degraded = 0;    // Decisions taken while sensor health was flagged
+  uint32_t sensor_faults = 0;      // Decision cycles skipped for a SENSOR_FAULT
+  uint32_t sample_gaps = 0;        // Late samples (loop stalled past 1.5 periods)
+  uint32_t samples_missed = 0;     // Acquisition slots lost in those gaps
   float detection_rate = 0.0;
   uint32_t last_reset = 0;
 } metrics = {0};
 
+// ============================================================================
+// FAST MATH KERNELS
+// ============================================================================
+
+/*
+ * Approximate sqrt, reciprocal and log for the per-sample and per-cycle math
+ *
+ * Each call site picks libm (exact) or the kernels below (fast) through
+ * its FAST_MATH_* switch. The mode is a compile-time constant, so the
+ * unused branch compiles away. The tables are generated by constexpr code
+ * at compile time and live in flash. Bounds hold for positive normal
+ * floats and are checked against libm by host/math_accuracy.cpp:
+ * - fastRsqrt: bit-level seed + 2 Newton steps, relative error < 5e-6
+ * - mathSqrt:  x * fastRsqrt(x), relative error < 5e-6, exactly 0 at 0
+ * - fastRecip: 64-entry seed table + 1 Newton step, relative error < 7e-5
+ * - fastLog2:  65-entry table + linear interpolation, absolute error < 5e-5
+ * - mathLog10: fastLog2 * log10(2), absolute error < 1.5e-5 (SNR: 3e-4 dB)
+ * Negative inputs, zero (except for mathSqrt), denormals, inf and NaN are
+ * not handled; the call sites never pass them.
+ *
+ * Only FAST_MATH_SNR is on by default: on the host the table log10 beats
+ * log10f, while libm's sqrt and division (hardware instructions there) beat
+ * the kernels. Turn FAST_MATH_FEATURES on once `mathbench` shows the fast
+ * sqrt ahead on the board. The reciprocal has no call site of its own:
+ * the quantized scorer already multiplies by precomputed reciprocals.
+ */
+
+#define MATH_TABLE_BITS 6
+#define MATH_TABLE_SIZE (1 << MATH_TABLE_BITS)
+
+constexpr double constexprLog2(double x) {
+  // ln x = 2 atanh((x - 1) / (x + 1)), |z| <= 1/3 on [1, 2]: 20 terms reach double precision
+  double z = (x - 1) / (x + 1), z2 = z * z, term = z, sum = 0;
+  for (int k = 0; k < 20; k++) {
+    sum += term / (2 * k + 1);
+    term *= z2;
+  }
+  return 2 * sum / 0.69314718055994530942;
+}
+
+struct MathTables {
+  float log2_mantissa[MATH_TABLE_SIZE + 1];  // log2(1 + i / SIZE)
+  float recip_mantissa[MATH_TABLE_SIZE];     // 1 / (1 + (i + 0.5) / SIZE)
+  
+  constexpr MathTables() : log2_mantissa(), recip_mantissa() {
+    for (int i = 0; i <= MATH_TABLE_SIZE; i++) {
+      log2_mantissa[i] = (float)constexprLog2(1.0 + (double)i / MATH_TABLE_SIZE);
+    }
+    for (int i = 0; i < MATH_TABLE_SIZE; i++) {
+      recip_mantissa[i] = (float)(1.0 / (1.0 + (i + 0.5) / MATH_TABLE_SIZE));
+    }
+  }
+};
+
+static constexpr MathTables math_tables;
+
+inline uint32_t floatBits(float x) { uint32_t b; memcpy(&b, &x, 4); return b; }
+inline float bitsFloat(uint32_t b) { float x; memcpy(&x, &b, 4); return x; }
+
+inline float fastRsqrt(float x) {
+  float y = bitsFloat(0x5F375A86u - (floatBits(x) >> 1));
+  y = y * (1.5f - 0.5f * x * y * y);
+  y = y * (1.5f - 0.5f * x * y * y);
+  return y;
+}
+
+inline float fastRecip(float x) {
+  uint32_t bits = floatBits(x);
+  float m = bitsFloat((bits & 0x007FFFFFu) | 0x3F800000u);  // mantissa in [1, 2)
+  float r = math_tables.recip_mantissa[(bits >> (23 - MATH_TABLE_BITS)) & (MATH_TABLE_SIZE - 1)];
+  r = r * (2.0f - m * r);
+  // 1 / (m * 2^e) = r * 2^-e, sign carried over
+  return r * bitsFloat(((254u - ((bits >> 23) & 0xFF)) << 23) | (bits & 0x80000000u));
+}
+
+inline float fastLog2(float x) {
+  uint32_t bits = floatBits(x);
+  int exponent = (int)((bits >> 23) & 0xFF) - 127;
+  uint32_t index = (bits >> (23 - MATH_TABLE_BITS)) & (MATH_TABLE_SIZE - 1);
+  float frac = (bits & ((1u << (23 - MATH_TABLE_BITS)) - 1)) * (1.0f / (1 << (23 - MATH_TABLE_BITS)));
+  float lo = math_tables.log2_mantissa[index];
+  return exponent + lo + (math_tables.log2_mantissa[index + 1] - lo) * frac;
+}
+
+inline float mathSqrt(float x, bool fast) { return fast ? x * fastRsqrt(x) : sqrtf(x); }
+inline float mathRecip(float x, bool fast) { return fast ? fastRecip(x) : 1.0f / x; }
+inline float mathLog10(float x, bool fast) {
+  return fast ? fastLog2(x) * 0.30102999566f : log10f(x);
+}
+
+void printMathBenchmark() {
+  // ns per call, exact vs fast, over inputs spread like window statistics
+  static float inputs[64];
+  for (int i = 0; i < 64; i++) inputs[i] = 1e-4f + i * 0.05f;
+  const int reps = 200;
+  const char* names[3] = {"sqrt", "recip", "log10"};
+  volatile float sink = 0;
+  
+  Serial.println("OK mathbench (ns/call exact | fast)");
+  for (int op = 0; op < 3; op++) {
+    uint32_t elapsed[2];
+    for (int fast = 0; fast < 2; fast++) {
+      uint32_t start = micros();
+      for (int r = 0; r < reps; r++) {
+        float acc = 0;
+        for (int i = 0; i < 64; i++) {
+          float x = inputs[i] + acc * 1e-30f;  // keep calls data-dependent
+          if (op == 0) acc += mathSqrt(x, fast);
+          else if (op == 1) acc += mathRecip(x, fast);
+          else acc += mathLog10(x, fast);
+        }
+        sink = acc;
+      }
+      elapsed[fast] = micros() - start;
+    }
+    Serial.printf("  %-6s %8.1f | %8.1f\n", names[op],
+                  elapsed[0] * 1000.0f / (reps * 64), elapsed[1] * 1000.0f / (reps * 64));
+  }
+  (void)sink;
+}
+
 // ============================================================================
 // SIGNAL CONDITIONING: LOW-PASS EXPONENTIAL FILTER
 // ============================================================================
@@ -102,8 +330,8 @@ public:
       return raw_value;
     }
     
-    filtered_value = (FILTER_ALPHA * raw_value) + 
-                     ((1.0 - FILTER_ALPHA) * filtered_value);
+    filtered_value = (tunables.filter_alpha * raw_value) + 
+                     ((1.0 - tunables.filter_alpha) * filtered_value);
     return filtered_value;
   }
   
@@ -128,266 +356,2295 @@ bool isOutlier(float value, float mean, float std_dev) {
 }
 
 // ============================================================================
-// CIRCULAR BUFFER MANAGEMENT
+// SENSOR HEALTH: NOISE FLOOR & SNR
 // ============================================================================
 
-void pushSensorReading(float raw_value, float filtered_value) {
-  sensor_buffer[buffer_index].raw_value = raw_value;
-  sensor_buffer[buffer_index].filtered_value = filtered_value;
-  sensor_buffer[buffer_index].timestamp = millis();
-  sensor_buffer[buffer_index].is_valid = true;
-  
-  buffer_index = (buffer_index + 1) % BUFFER_SIZE;
-  sensor_samples_collected++;
-}
+/*
+ * Live version of the calibration utility's noise and SNR measurement
+ *
+ * Noise is the RMS of first differences of raw samples: slow process
+ * changes barely move it, while connector, grounding and sensor faults
+ * raise it directly. Signal spread is an exponentially weighted variance
+ * of the raw samples, and SNR = 20*log10(signal_std / noise_rms) as in
+ * calibration_utility.cpp. Both are O(1) per sample. Each squared
+ * difference is clipped at NOISE_CLIP_FACTOR times the running mean, so a
+ * single process step barely moves the floor while sustained noise still
+ * raises it within tens of samples. The noise floor at
+ * the end of learning is the reference: rising above NOISE_DEGRADE_RATIO
+ * times it flags the sensor until it falls back below NOISE_RECOVER_RATIO.
+ *
+ * Broadband process variance (a variance burst) raises first differences
+ * just as sensor noise does, and no filter tells them apart. What does is
+ * the process decision: an anomalous decision rolls the floor back to its
+ * value at the last normal decision and holds it there until decisions
+ * are normal again, so a process anomaly cannot raise the sensor flag.
+ * A degrading sensor can be noisy enough to score as a process anomaly
+ * too, so the hold lasts at most NOISE_HOLD_MAX_MS per episode; noise
+ * that stays up longer is taken as the sensor's and the floor follows it
+ * again.
+ *
+ * With ENABLE_NOISE_RETUNE, filter_alpha is divided by the square of the
+ * noise ratio when the flag is raised, which keeps the filtered noise
+ * variance near its learned level, and restored on recovery.
+ */
 
-int getValidSamplesCount() {
-  int count = 0;
-  for (int i = 0; i < BUFFER_SIZE; i++) {
-    if (sensor_buffer[i].is_valid) count++;
+class NoiseFloorMonitor {
+private:
+  float prev_raw = 0;
+  float diff_sq = 0;        // EWMA of squared first differences
+  float signal_mean = 0;
+  float signal_var = 0;     // EWMA variance of the raw samples
+  float learned_noise = 0;  // 0 until a baseline is latched
+  float learned_alpha = 0;  // filter_alpha before retuning
+  float normal_diff_sq = 0; // diff_sq at the last normal decision
+  uint16_t warmup = 0;      // samples seen, saturating at 1 / NOISE_EWMA_ALPHA
+  bool primed = false;
+  bool held = false;        // process anomaly: floor frozen
+  bool hold_spent = false;  // held for NOISE_HOLD_MAX_MS in this episode
+  uint32_t held_since_ms = 0;
+  bool degraded = false;
+  
+  void retune(bool enable) {
+#if ENABLE_NOISE_RETUNE
+    if (enable) {
+      float ratio = noiseRms() / learned_noise;
+      learned_alpha = tunables.filter_alpha;
+      tunables.filter_alpha = fmax(0.01, learned_alpha / (ratio * ratio));
+    } else if (learned_alpha > 0) {
+      tunables.filter_alpha = learned_alpha;
+      learned_alpha = 0;
+    }
+#else
+    (void)enable;
+#endif
   }
-  return count;
-}
-
-// ============================================================================
-// FEATURE EXTRACTION: STATISTICAL MOMENTS
-// ============================================================================
-
-Features_t extractFeatures() {
-  Features_t features = {0};
   
-  int valid_count = 0;
-  float sum = 0, sum_sq = 0, min_val = FLT_MAX, max_val = -FLT_MAX;
+  void checkFloor() {
+    if (learned_noise <= 0) return;
+    float ratio = noiseRms() / learned_noise;
+    if (!degraded && ratio > NOISE_DEGRADE_RATIO) {
+      degraded = true;
+      retune(true);
+    } else if (degraded && ratio < NOISE_RECOVER_RATIO) {
+      degraded = false;
+      retune(false);
+    }
+  }
   
-  // Collect statistics from the most recent FEATURE_WINDOW samples
-  int start_idx = (buffer_index - FEATURE_WINDOW + BUFFER_SIZE) % BUFFER_SIZE;
+public:
+  void update(float raw_value) {
+    if (!primed) {
+      prev_raw = raw_value;
+      signal_mean = raw_value;
+      primed = true;
+      return;
+    }
+    
+    float deviation = raw_value - signal_mean;
+    signal_mean += NOISE_EWMA_ALPHA * deviation;
+    signal_var = (1.0 - NOISE_EWMA_ALPHA) * (signal_var + NOISE_EWMA_ALPHA * deviation * deviation);
+    
+    float diff = raw_value - prev_raw;
+    prev_raw = raw_value;
+    if (held) return;
+    float sq = diff * diff;
+    if (warmup < 1.0 / NOISE_EWMA_ALPHA) warmup++;
+    else sq = fmin(sq, diff_sq * NOISE_CLIP_FACTOR);
+    diff_sq += NOISE_EWMA_ALPHA * (sq - diff_sq);
+    checkFloor();
+  }
   
-  for (int i = 0; i < FEATURE_WINDOW; i++) {
-    int idx = (start_idx + i) % BUFFER_SIZE;
-    if (sensor_buffer[idx].is_valid) {
-      float val = sensor_buffer[idx].filtered_value;
-      sum += val;
-      sum_sq += val * val;
-      min_val = fmin(min_val, val);
-      max_val = fmax(max_val, val);
-      valid_count++;
+  void holdForProcess(bool anomalous, uint32_t now_ms) {
+    // Once per decision, before its sensor health is read
+    if (!anomalous) {
+      held = hold_spent = false;
+      normal_diff_sq = diff_sq;
+    } else if (!held && !hold_spent) {
+      held = true;
+      held_since_ms = now_ms;
+      if (normal_diff_sq > 0) diff_sq = normal_diff_sq;
+      checkFloor();
+    } else if (held && now_ms - held_since_ms >= NOISE_HOLD_MAX_MS) {
+      held = false;
+      hold_spent = true;
     }
   }
   
-  if (valid_count == 0) return features;
+  void latchBaseline() { learned_noise = fmax(noiseRms(), 1e-5); }
   
-  // Mean
-  features.mean = sum / valid_count;
+  void clearBaseline() {
+    if (degraded) retune(false);
+    learned_noise = 0;
+    normal_diff_sq = 0;
+    held = hold_spent = false;
+    degraded = false;
+  }
   
-  // Standard Deviation
-  float variance = (sum_sq / valid_count) - (features.mean * features.mean);
-  features.std_dev = sqrt(fmax(variance, 0.0));  // Avoid negative due to floating point errors
+  float noiseRms() const { return mathSqrt(diff_sq, FAST_MATH_FEATURES); }
+  float noiseVar() const { return diff_sq; }  // noiseRms()^2 without the root, for per-sample tests
+  float learnedNoiseRms() const { return learned_noise; }
   
-  // Min/Max Range
-  features.min_val = min_val;
-  features.max_val = max_val;
+  float snrDb() const {
+    float noise = noiseRms();
+    if (noise < 1e-6) return 80;  // Very clean signal
+    return 20 * mathLog10(fmaxf(mathSqrt(signal_var, FAST_MATH_FEATURES), 1e-6f) / noise,
+                          FAST_MATH_SNR);
+  }
   
-  // RMS (Root Mean Square) - effective value for signals
-  features.rms = sqrt(sum_sq / valid_count);
+  bool isDegraded() const { return degraded; }
+};
+
+NoiseFloorMonitor noise_monitor;
+
+/*
+ * Integer fast path for broken inputs, ahead of all float processing
+ *
+ * A frozen sensor repeats one code, a shorted or open input sits on a
+ * rail, and a floating GPIO jumps by large fractions of full scale. Each
+ * is tracked in O(1) on the raw ADC code: a run length of identical codes,
+ * a run length of rail codes, and an 8-sample shift register of implausible
+ * slews. Any of them raises SENSOR_FAULT within FAULT_RAIL_RUN to
+ * FAULT_STUCK_RUN samples; faulted samples never reach the filter, the
+ * window or the noise floor, and the fault clears only after
+ * FAULT_CLEAR_SAMPLES clean samples in a row. Rail codes and implausible
+ * jumps are held back even before a fault is confirmed, so the samples
+ * that lead up to one do not leak into the window either.
+ *
+ * The runs count samples, not time, so a slowed-down acquisition would
+ * stretch them: FAULT_STUCK_RUN codes take 2 s at an 80 ms period. A run
+ * of FAULT_STUCK_SUSPECT identical codes therefore drops the rate
+ * controller back to SAMPLE_PERIOD_MS, and the rest of the run is counted
+ * at the nominal rate (under 0.7 s from the freeze at any period). Short
+ * runs occur naturally on a quiet signal; each costs one speed-up of the
+ * controller, never a fault.
+ */
+
+typedef enum {
+  FAULT_NONE = 0,
+  FAULT_STUCK,
+  FAULT_RAIL_LOW,
+  FAULT_RAIL_HIGH,
+  FAULT_FLOATING
+} SensorFault_t;
+
+class SensorFaultDetector {
+private:
+  int prev_code = -1;
+  uint16_t same_run = 0;
+  uint16_t rail_run = 0;
+  uint8_t slew_bits = 0;    // bit i set: sample i ago jumped > FAULT_SLEW_CODES
+  uint16_t clean_run = 0;
+  SensorFault_t fault = FAULT_NONE;
   
-  // Trend: Linear regression slope over the window
-  float sum_x = 0, sum_y = 0, sum_xy = 0, sum_x2 = 0;
-  for (int i = 0; i < FEATURE_WINDOW; i++) {
-    int idx = (start_idx + i) % BUFFER_SIZE;
-    if (sensor_buffer[idx].is_valid) {
-      float x = i;
-      float y = sensor_buffer[idx].filtered_value;
-      sum_x += x;
-      sum_y += y;
-      sum_xy += x * y;
-      sum_x2 += x * x;
+public:
+  uint32_t onsets = 0;
+  
+  // Returns true when the sample must be skipped: faulted or suspect
+  bool update(int code) {
+    bool jump = prev_code >= 0 && abs(code - prev_code) > FAULT_SLEW_CODES;
+    same_run = (code == prev_code) ? same_run + 1 : 1;
+    rail_run = (code <= 0 || code >= ADC_MAX_CODE) ? rail_run + 1 : 0;
+    slew_bits = (slew_bits << 1) | (jump ? 1 : 0);
+    prev_code = code;
+    
+    SensorFault_t now = FAULT_NONE;
+    if (rail_run >= FAULT_RAIL_RUN) now = (code <= 0) ? FAULT_RAIL_LOW : FAULT_RAIL_HIGH;
+    else if (__builtin_popcount(slew_bits) >= FAULT_SLEW_HITS) now = FAULT_FLOATING;
+    else if (same_run >= FAULT_STUCK_RUN) now = FAULT_STUCK;
+    
+    if (now != FAULT_NONE) {
+      if (fault == FAULT_NONE) onsets++;
+      fault = now;
+      clean_run = 0;
+    } else if (fault != FAULT_NONE && ++clean_run >= FAULT_CLEAR_SAMPLES) {
+      fault = FAULT_NONE;
     }
+    return fault != FAULT_NONE || rail_run > 0 || jump;
   }
   
-  float n = valid_count;
-  float denominator = (n * sum_x2) - (sum_x * sum_x);
-  if (fabs(denominator) > 0.001) {
-    features.trend = ((n * sum_xy) - (sum_x * sum_y)) / denominator;
-  } else {
-    features.trend = 0;
+  void reset() {
+    prev_code = -1;
+    same_run = rail_run = clean_run = 0;
+    slew_bits = 0;
+    fault = FAULT_NONE;
   }
   
-  return features;
-}
+  SensorFault_t current() const { return fault; }
+  
+  // True on the sample that makes a run of identical codes suspicious
+  bool stuckRunStarting() const { return same_run == FAULT_STUCK_SUSPECT; }
+  
+  const char* name() const { return name(fault); }
+  
+  static const char* name(SensorFault_t fault) {
+    switch (fault) {
+      case FAULT_STUCK:     return "STUCK";
+      case FAULT_RAIL_LOW:  return "RAIL_LOW";
+      case FAULT_RAIL_HIGH: return "RAIL_HIGH";
+      case FAULT_FLOATING:  return "FLOATING";
+      default:              return "NONE";
+    }
+  }
+};
+
+SensorFaultDetector sensor_fault;
 
 // ============================================================================
-// ISOLATION FOREST: LIGHTWEIGHT ANOMALY SCORING
+// ENVELOPE DEMODULATION: BEARING & GEAR FAULTS
 // ============================================================================
 
 /*
- * Simplified Isolation Forest Implementation
- * 
- * Principle: Anomalies are isolated with fewer splits in a random forest
- * of binary trees. This is a lightweight version suitable for embedded systems.
- * 
- * Instead of full trees, we use simple isolation rules based on feature ranges
+ * Amplitude modulation of a structural resonance
+ *
+ * Rolling-element and gear-tooth faults strike a resonance once per
+ * defect passage, so the fault shows as a modulation of that resonance
+ * long before it moves mean, std_dev or rms. Each raw ADC code runs
+ * through: a band-pass biquad around the resonance (zeros at DC and
+ * Nyquist, so no DC removal is needed), full-wave rectification, a
+ * shift-based low-pass, and decimation by ENVELOPE_DECIMATION. Envelope
+ * samples are kept until a block of ENVELOPE_BLOCK is complete; one DFT
+ * pass over the block then sums bins 1..BLOCK/2 into ENVELOPE_BANDS
+ * equal bands, and each band's power is smoothed across blocks. A carrier of constant amplitude only reaches
+ * the DC bin, so the bands see modulation and not the resonance itself.
+ *
+ * Everything per sample is integer: Q14 coefficients and twiddles
+ * (computed once), a Q4 envelope, 64-bit accumulators. Cost per raw
+ * sample is 3 multiplies, plus BLOCK / DECIMATION multiplies for the
+ * DFT on average, paid once per block; this fits kHz acquisition rates. Frequencies scale with the
+ * nominal rate: at 100 Hz the band-pass sits at 25 Hz and the bands span
+ * 0.8-12.5 Hz of modulation in 3.1 Hz steps. The stage only runs at the
+ * nominal SAMPLE_PERIOD_MS and restarts when the rate returns to it.
+ *
+ * The mean block power of each band over the learning phase is its
+ * reference. A band above ENVELOPE_ALERT_RATIO times its reference flags
+ * modulation until every band is back below half that ratio. References
+ * are floored at a modulation of a quarter ADC code, so a very quiet
+ * baseline cannot alert on quantization noise.
  */
 
-class LightweightIsolationForest {
+class EnvelopeDemodulator {
 private:
-  struct SplitRule {
-    int feature_idx;      // 0=mean, 1=std_dev, 2=rms, 3=min, 4=max, 5=trend
-    float threshold;
-    float lower_bound, upper_bound;
-  };
-  
-  static const int NUM_TREES = 5;
-  static const int MAX_DEPTH = 8;
-  
-  SplitRule trees[NUM_TREES];
-  float feature_ranges[6][2];  // min/max for each feature
-  
-public:
-  LightweightIsolationForest() {
-    initializeFeatureRanges();
-  }
+  static const int BINS = ENVELOPE_BLOCK / 2;
+  static const int BINS_PER_BAND = BINS / ENVELOPE_BANDS;
   
-  void initializeFeatureRanges() {
-    // Safe default ranges
-    feature_ranges[0][0] = -100; feature_ranges[0][1] = 100;  // mean
-    feature_ranges[1][0] = 0;    feature_ranges[1][1] = 50;   // std_dev
-    feature_ranges[2][0] = 0;    feature_ranges[2][1] = 100;  // rms
-    feature_ranges[3][0] = -100; feature_ranges[3][1] = 100;  // min
-    feature_ranges[4][0] = -100; feature_ranges[4][1] = 100;  // max
-    feature_ranges[5][0] = -10;  feature_ranges[5][1] = 10;   // trend
-  }
+  int16_t cos_q14[ENVELOPE_BLOCK], sin_q14[ENVELOPE_BLOCK];
+  int32_t b0, a1, a2;           // band-pass coefficients, Q14 (b1 = 0, b2 = -b0)
+  int32_t x1 = 0, x2 = 0;       // input history (ADC codes)
+  int32_t y1 = 0, y2 = 0;       // output history (Q4 codes)
+  int32_t env = 0;              // low-passed rectified band-pass output (Q4)
+  int32_t block_ref = 0;        // previous block's mean envelope, removed before the DFT
+  int64_t block_sum = 0;
+  int32_t block_env[ENVELOPE_BLOCK];  // envelope less block_ref, this block
+  bool primed = false;          // input history holds real samples
+  uint8_t phase = 0;            // raw samples since the last envelope sample
+  uint8_t n = 0;                // envelope samples in the current block
+  int64_t level[ENVELOPE_BANDS];    // band power smoothed over blocks
+  int64_t learned[ENVELOPE_BANDS];  // 0 until a baseline is latched
+  int64_t learn_sum[ENVELOPE_BANDS];  // block powers since clearBaseline()
+  uint16_t learn_blocks = 0;
+  uint16_t blocks = 0;
+  bool modulated = false;
   
-  void updateFeatureRanges(const Features_t& features, float mean_baseline, float std_baseline) {
-    // Dynamically expand ranges based on observed values during learning
-    feature_ranges[0][0] = fmin(feature_ranges[0][0], features.mean - std_baseline);
-    feature_ranges[0][1] = fmax(feature_ranges[0][1], features.mean + std_baseline);
+  void completeBlock() {
+    block_ref = (int32_t)(block_sum / ENVELOPE_BLOCK);
+    block_sum = 0;
     
-    feature_ranges[1][0] = fmin(feature_ranges[1][0], features.std_dev * 0.5);
-    feature_ranges[1][1] = fmax(feature_ranges[1][1], features.std_dev * 1.5);
+    for (int b = 0; b < ENVELOPE_BANDS; b++) {
+      int64_t power = 0;
+      for (int k = 1 + b * BINS_PER_BAND; k <= (b + 1) * BINS_PER_BAND; k++) {
+        int64_t re = 0, im = 0;
+        for (int i = 0; i < ENVELOPE_BLOCK; i++) {
+          int idx = (k * i) & (ENVELOPE_BLOCK - 1);
+          re += (int64_t)block_env[i] * cos_q14[idx];
+          im -= (int64_t)block_env[i] * sin_q14[idx];
+        }
+        re >>= 14;
+        im >>= 14;
+        power += re * re + im * im;
+      }
+      // Rises are averaged over blocks, so a lone step cannot alert; falls
+      // are taken at once, so the flag clears as soon as the cause is gone.
+      // The first block after a restart is averaged against the reference.
+      int64_t previous = (blocks == 0) ? learned[b] : level[b];
+      level[b] = (power < previous || (blocks == 0 && learned[b] == 0)) ? power :
+                 previous + ((power - previous) >> 1);
+      if (learned[0] == 0) learn_sum[b] += power;
+    }
+    if (learned[0] == 0 && learn_blocks < 0xFFFF) learn_blocks++;
+    n = 0;
+    if (blocks < 0xFFFF) blocks++;
     
-    feature_ranges[2][0] = fmin(feature_ranges[2][0], features.rms * 0.5);
-    feature_ranges[2][1] = fmax(feature_ranges[2][1], features.rms * 1.5);
+    if (learned[0] == 0) return;
+    bool above = false, below = true;
+    for (int b = 0; b < ENVELOPE_BANDS; b++) {
+      if (level[b] > learned[b] * ENVELOPE_ALERT_RATIO) above = true;
+      if (level[b] * 2 > learned[b] * ENVELOPE_ALERT_RATIO) below = false;
+    }
+    if (above) modulated = true;
+    else if (below) modulated = false;
   }
   
-  float anomalyScore(const Features_t& features) {
-    /*
-     * Anomaly Scoring Logic:
-     * - For each feature, calculate deviation from baseline ranges
-     * - Deviations beyond normal range increase anomaly score
-     * - Score normalized to [0, 1]
-     */
-    
-    float score = 0.0;
-    int violation_count = 0;
-    
-    // Deviation from mean range
-    if (features.mean < feature_ranges[0][0] || features.mean > feature_ranges[0][1]) {
-      float deviation = (features.mean < feature_ranges[0][0]) ?
-                        (feature_ranges[0][0] - features.mean) :
-                        (features.mean - feature_ranges[0][1]);
-      float range_width = feature_ranges[0][1] - feature_ranges[0][0];
-      score += fmin(1.0, deviation / range_width);
-      violation_count++;
+public:
+  EnvelopeDemodulator() {
+    // RBJ band-pass (0 dB peak), designed once in float
+    float w0 = 2 * M_PI * ENVELOPE_CENTER_FRACTION;
+    float alpha = sin(w0) / (2 * ENVELOPE_Q);
+    float a0 = 1 + alpha;
+    b0 = (int32_t)lround(16384 * alpha / a0);
+    a1 = (int32_t)lround(16384 * -2 * cos(w0) / a0);
+    a2 = (int32_t)lround(16384 * (1 - alpha) / a0);
+    for (int i = 0; i < ENVELOPE_BLOCK; i++) {
+      cos_q14[i] = (int16_t)lround(16384 * cos(2 * M_PI * i / ENVELOPE_BLOCK));
+      sin_q14[i] = (int16_t)lround(16384 * sin(2 * M_PI * i / ENVELOPE_BLOCK));
     }
-    
-    // Deviation from std_dev range
-    if (features.std_dev > feature_ranges[1][1]) {
-      float deviation = features.std_dev - feature_ranges[1][1];
-      float range_width = feature_ranges[1][1] - feature_ranges[1][0];
-      score += fmin(1.0, deviation / range_width);
-      violation_count++;
+    clearBaseline();
+    restart();
+  }
+  
+  void update(int code, uint16_t period_ms) {
+    if (period_ms != SAMPLE_PERIOD_MS) {
+      // Filters are designed for the nominal rate
+      if (blocks > 0 || n > 0) restart();
+      return;
     }
     
-    // Deviation from RMS range
-    if (features.rms > feature_ranges[2][1]) {
-      float deviation = features.rms - feature_ranges[2][1];
-      float range_width = feature_ranges[2][1] - feature_ranges[2][0];
-      score += fmin(1.0, deviation / range_width);
-      violation_count++;
+    if (!primed) {
+      // Start from a settled filter instead of ringing on a step from 0
+      x1 = x2 = code;
+      primed = true;
     }
+    int64_t acc = ((int64_t)b0 * (code - x2) << 4) - (int64_t)a1 * y1 - (int64_t)a2 * y2;
+    int32_t y = (int32_t)(acc >> 14);
+    x2 = x1; x1 = code;
+    y2 = y1; y1 = y;
     
-    // Range compression detection (abnormally stable)
-    float range = features.max_val - features.min_val;
-    float expected_range = anomaly_model.baseline_rms * 2.0;
-    if (range < expected_range * 0.1 && anomaly_model.baseline_rms > 1.0) {
-      score += 0.3;  // Anomalous stability
-      violation_count++;
-    }
+    int32_t rectified = (y < 0) ? -y : y;
+    env += (rectified - env) >> ENVELOPE_LPF_SHIFT;
+    if (++phase < ENVELOPE_DECIMATION) return;
+    phase = 0;
     
-    // Extreme trend changes
-    if (fabs(features.trend) > 5.0) {
-      score += 0.4;
-      violation_count++;
+    block_env[n] = env - block_ref;
+    block_sum += env;
+    if (++n == ENVELOPE_BLOCK) completeBlock();
+  }
+  
+  void restart() {
+    x1 = x2 = y1 = y2 = env = 0;
+    primed = false;
+    block_ref = 0;
+    block_sum = 0;
+    for (int b = 0; b < ENVELOPE_BANDS; b++) level[b] = 0;
+    phase = n = 0;
+    blocks = 0;
+  }
+  
+  void latchBaseline() {
+    // Quarter code of envelope modulation in a bin: (BLOCK / 2 * 4)^2 in Q4
+    const int64_t floor_power = (int64_t)(BINS * 4) * (BINS * 4);
+    for (int b = 0; b < ENVELOPE_BANDS; b++) {
+      int64_t mean = (learn_blocks > 0) ? learn_sum[b] / learn_blocks : 0;
+      learned[b] = (mean > floor_power) ? mean : floor_power;
     }
-    
-    // Normalize score
-    if (violation_count > 0) {
-      score = score / (violation_count * 1.0);
+    modulated = false;
+  }
+  
+  void clearBaseline() {
+    for (int b = 0; b < ENVELOPE_BANDS; b++) learned[b] = learn_sum[b] = 0;
+    learn_blocks = 0;
+    modulated = false;
+  }
+  
+  float bandAmplitude(int band) const {
+    // Band power -> modulation amplitude in volts (bin magnitude = BLOCK/2 * amplitude)
+    return sqrt((float)level[band]) * (1.0f / (BINS * 16)) * (3.3f / 4095.0f);
+  }
+  
+  float ratio() const {
+    // Largest band power relative to its reference (0 before latching)
+    float worst = 0;
+    for (int b = 0; b < ENVELOPE_BANDS; b++) {
+      if (learned[b] > 0) worst = fmax(worst, (float)level[b] / learned[b]);
     }
-    
-    return fmin(1.0, score);
+    return worst;
   }
+  
+  bool isModulated() const { return modulated; }
 };
 
-LightweightIsolationForest isolation_forest;
+EnvelopeDemodulator envelope_demod;
 
 // ============================================================================
-// LEARNING PHASE: BASELINE ESTABLISHMENT
+// AR RESIDUAL: SAMPLE-TO-SAMPLE DYNAMICS
 // ============================================================================
 
-void enterLearningPhase() {
-  learning_phase_active = true;
-  learning_start_time = millis();
-  sensor_samples_collected = 0;
-  
-  Serial.println("\n========== LEARNING PHASE STARTED ==========");
-  Serial.println("Duration: 60 seconds");
-  Serial.println("Establishing baseline normal behavior...");
-  Serial.println("===========================================\n");
-}
+/*
+ * Does each sample still follow from the ones before it?
+ *
+ * Window statistics summarize a window but not how one sample leads to
+ * the next, so a new oscillation or damping change can keep mean,
+ * std_dev and rms in range. An AR(AR_ORDER) model predicts every raw
+ * sample (in mV, less a slow level so no intercept is needed) from the
+ * previous AR_ORDER, and recursive least squares refits it per sample
+ * with exponential forgetting: O(p^2) float operations, ~60 multiplies
+ * at p = 4, and no window to revisit. The covariance is only inflated by
+ * the forgetting factor while its trace stays bounded, so a quiet input
+ * cannot wind it up.
+ *
+ * The a-priori residual e is normalized by its predicted variance,
+ * z^2 = e^2 / (sigma^2 * (1 + phi' P phi)), with sigma^2 the mean over the
+ * learning phase (floored at ADC quantization noise). z^2 is ~1 per
+ * sample while the dynamics are the learned ones; clipped at
+ * AR_RESIDUAL_CLIP and smoothed, it is the ar_residual feature. Above
+ * AR_ALERT_RATIO it flags a dynamics change until it falls below half;
+ * with AR_RESIDUAL_VOTES that flag makes a decision anomalous by itself.
+ * The model keeps adapting, so a lasting change shows as a burst of about
+ * 1 / (1 - AR_FORGETTING) samples. Raw samples are used because the
+ * input filter smooths away the dynamics; the model restarts when the
+ * sample period changes and scores nothing for AR_SETTLE_SAMPLES.
+ */
 
-void completeLearningPhase() {
-  if (sensor_samples_collected < 30) {
-    Serial.println("[WARNING] Insufficient samples during learning phase");
-    return;
-  }
+class ArResidualDetector {
+private:
+  static const int P_ORDER = AR_ORDER;
   
-  learning_phase_active = false;
+  float theta[P_ORDER];         // AR coefficients
+  float cov[P_ORDER][P_ORDER];  // RLS inverse-correlation matrix
+  float history[P_ORDER];       // previous centred samples (mV), newest first
+  float baseline_mv = 0;        // slow level removed from the input
+  float z2 = 0;                 // newest squared normalized residual
+  float level = 0;              // smoothed z2
+  float learned_var = 0;        // 0 until a baseline is latched
+  float learn_mean = 0;         // mean normalized squared residual since clearBaseline()
+  uint32_t learn_count = 0;
+  uint16_t seen = 0;            // samples since restart()
+  uint16_t last_period = 0;
+  bool changed = false;
   
-  // Extract features after learning period
-  current_features = extractFeatures();
+public:
+  ArResidualDetector() {
+    clearBaseline();
+    restart();
+  }
   
-  // Establish baseline thresholds
-  anomaly_model.baseline_mean = current_features.mean;
-  anomaly_model.baseline_std = current_features.std_dev;
-  anomaly_model.baseline_rms = current_features.rms;
+  void update(float raw_volts, uint16_t period_ms) {
+    if (period_ms != last_period) {
+      // Coefficients describe one sample spacing
+      last_period = period_ms;
+      restart();
+    }
+    float mv = raw_volts * 1000;
+    if (seen == 0) baseline_mv = mv;
+    baseline_mv += (mv - baseline_mv) * (1.0f / 64);
+    float y = mv - baseline_mv;
+    
+    if (seen >= P_ORDER) {
+      // Gain k = P phi / (lambda + phi' P phi); the error is a priori
+      float p_phi[P_ORDER];
+      float prediction = 0, h = 0;
+      for (int i = 0; i < P_ORDER; i++) {
+        float acc = 0;
+        for (int j = 0; j < P_ORDER; j++) acc += cov[i][j] * history[j];
+        p_phi[i] = acc;
+        prediction += theta[i] * history[i];
+        h += history[i] * acc;
+      }
+      float e = y - prediction;
+      float inv_s = 1.0f / (AR_FORGETTING + h);
+      for (int i = 0; i < P_ORDER; i++) theta[i] += p_phi[i] * inv_s * e;
+      
+      float trace = 0;
+      for (int i = 0; i < P_ORDER; i++) trace += cov[i][i];
+      float inflate = (trace < 1e4f) ? 1.0f / AR_FORGETTING : 1.0f;  // windup bound
+      for (int i = 0; i < P_ORDER; i++) {
+        for (int j = i; j < P_ORDER; j++) {
+          cov[i][j] = (cov[i][j] - p_phi[i] * p_phi[j] * inv_s) * inflate;
+          cov[j][i] = cov[i][j];
+        }
+      }
+      
+      if (seen >= AR_SETTLE_SAMPLES) {
+        float normalized = e * e / (1 + h);
+        if (learned_var == 0) {
+          learn_count++;
+          learn_mean += (normalized - learn_mean) / learn_count;
+        } else {
+          z2 = fmin(normalized / learned_var, AR_RESIDUAL_CLIP);
+          level += (z2 - level) * (1.0f / (1 << AR_SMOOTHING_SHIFT));
+          if (level > AR_ALERT_RATIO) changed = true;
+          else if (level * 2 < AR_ALERT_RATIO) changed = false;
+        }
+      }
+    }
+    
+    for (int i = P_ORDER - 1; i > 0; i--) history[i] = history[i - 1];
+    history[0] = y;
+    if (seen < 0xFFFF) seen++;
+  }
   
-  // Adaptive threshold: 2 standard deviations from baseline + margin
-  anomaly_model.adaptive_threshold = 
-    ANOMALY_THRESHOLD + (current_features.std_dev * 0.15);
+  void restart() {
+    for (int i = 0; i < P_ORDER; i++) {
+      theta[i] = history[i] = 0;
+      for (int j = 0; j < P_ORDER; j++) cov[i][j] = (i == j) ? 100.0f : 0;  // weak prior
+    }
+    z2 = 0;
+    level = 1;
+    seen = 0;
+    changed = false;
+  }
   
-  // Update isolation forest ranges
-  isolation_forest.updateFeatureRanges(current_features, 
-                                       current_features.mean, 
-                                       current_features.std_dev);
+  void latchBaseline() {
+    // Floor: quantization noise of one ADC code, (3300 / 4095)^2 / 12 mV^2
+    const float floor_var = (3300.0f / 4095) * (3300.0f / 4095) / 12;
+    learned_var = fmax(learn_mean, floor_var);
+    level = 1;
+    changed = false;
+  }
   
-  Serial.println("\n========== LEARNING PHASE COMPLETED ==========");
-  Serial.printf("Samples collected: %u\n", sensor_samples_collected);
-  Serial.printf("Baseline Mean: %.2f\n", anomaly_model.baseline_mean);
-  Serial.printf("Baseline Std Dev: %.2f\n", anomaly_model.baseline_std);
-  Serial.printf("Baseline RMS: %.2f\n", anomaly_model.baseline_rms);
-  Serial.printf("Adaptive Threshold: %.3f\n", anomaly_model.adaptive_threshold);
-  Serial.println("System ready for anomaly detection\n");
+  void clearBaseline() {
+    learned_var = learn_mean = 0;
+    learn_count = 0;
+    level = 1;
+    changed = false;
+  }
   
-  metrics.last_reset = millis();
-}
+  float lastScore() const { return z2; }       // per-sample z^2 (0 before latching)
+  float residualLevel() const { return (learned_var > 0) ? level : 0; }
+  bool isChanged() const { return changed; }
+};
+
+ArResidualDetector ar_residual;
 
 // ============================================================================
-// ADAPTIVE THRESHOLD ADJUSTMENT
+// ADAPTIVE WINDOW: EXPONENTIAL-HISTOGRAM CHANGE DETECTION
 // ============================================================================
 
-void updateAdaptiveThreshold() {
-  /*
+/*
+ * Variable-length feature window (ADWIN-style)
+ *
+ * Raw samples are summarized in an exponential histogram: buckets of 1,
+ * 2, 4, ... samples, at most ADWIN_BUCKETS_PER_LEVEL per size before the
+ * two oldest of a size merge, so a window of W samples needs O(log W)
+ * buckets. Each bucket keeps count, mean and sum of squared deviations,
+ * merged exactly with Chan's pairwise formula. After every sample (every
+ * run in processBlock()), each bucket boundary splits the window into an
+ * older and a newer part; when their means differ by more than the
+ * Bernstein-style bound (compared squared, so no root per boundary)
+ *   eps = sqrt(2 * var * ln(2 / delta') / m),  m = 1 / (1/n0 + 1/n1)
+ * the oldest bucket is dropped and the test repeats. The effective
+ * feature window is the surviving length, clamped to
+ * [ADAPTIVE_WINDOW_MIN, feature_window]: it collapses onto the samples
+ * after a change and grows back by one per sample while the signal is
+ * stationary. Buckets are indivisible, so the samples kept at a cut can
+ * still straddle the change, and filtered values blend both regimes for
+ * about 3 / filter_alpha samples after it: the window only grows again
+ * from samples newer than both. Raw
+ * samples are tested because the low-pass filter's autocorrelation
+ * would make the bound far too optimistic.
+ */
+
+class AdaptiveWindow {
+private:
+  static const int MAX_BUCKETS = 8 * (ADWIN_BUCKETS_PER_LEVEL + 1);
+  
+  struct Bucket {
+    uint16_t count;
+    float mean;   // relative to shift
+    float m2;     // sum of squared deviations from mean
+  };
+  
+  Bucket buckets[MAX_BUCKETS];  // oldest first
+  int num_buckets = 0;
+  uint16_t total = 0;
+  uint16_t settling = 0;        // oldest samples held out after the last cut
+  float shift = 0;
+  bool has_shift = false;
+  
+  static void merge(Bucket& into, const Bucket& other) {
+    float n = into.count + other.count;
+    float delta = other.mean - into.mean;
+    into.m2 += other.m2 + delta * delta * into.count * other.count / n;
+    into.mean += delta * other.count / n;
+    into.count += other.count;
+  }
+  
+  void dropOldest() {
+    total -= buckets[0].count;
+    num_buckets--;
+    memmove(&buckets[0], &buckets[1], num_buckets * sizeof(Bucket));
+  }
+  
+  void compress() {
+    // Buckets of one size are contiguous; merge the two oldest of any
+    // size that has too many, which may cascade into the next size up
+    int run_end = num_buckets;
+    while (run_end > 0) {
+      int run_start = run_end - 1;
+      while (run_start > 0 && buckets[run_start - 1].count == buckets[run_end - 1].count) {
+        run_start--;
+      }
+      if (run_end - run_start <= ADWIN_BUCKETS_PER_LEVEL) {
+        run_end = run_start;
+        continue;
+      }
+      merge(buckets[run_start], buckets[run_start + 1]);
+      num_buckets--;
+      memmove(&buckets[run_start + 1], &buckets[run_start + 2],
+              (num_buckets - run_start - 1) * sizeof(Bucket));
+      run_end = run_start + 1;
+    }
+  }
+  
+  bool detectChange() {
+    Bucket all = buckets[0];
+    for (int i = 1; i < num_buckets; i++) merge(all, buckets[i]);
+    
+    // Variance floor: ADC quantization noise of one code
+    const float lsb = 3.3 / 4095.0;
+    float variance = fmax(all.m2 / all.count, lsb * lsb / 12.0);
+    float log_term = log(2.0 * log((float)total) / ADWIN_DELTA);
+    float floor_sq = ADWIN_MIN_SHIFT * ADWIN_MIN_SHIFT * variance;
+    
+    Bucket older = {0, 0, 0};
+    for (int i = 0; i < num_buckets - 1; i++) {
+      if (older.count == 0) older = buckets[i];
+      else merge(older, buckets[i]);
+      
+      float n0 = older.count;
+      float n1 = total - older.count;
+      if (n0 < ADAPTIVE_WINDOW_MIN / 2 || n1 < ADAPTIVE_WINDOW_MIN / 2) continue;
+      
+      // Newer mean from the totals, no second pass needed
+      float newer_mean = (all.mean * total - older.mean * n0) / n1;
+      // Compared squared: eps^2 = 2 var ln(2 / delta') (1/n0 + 1/n1)
+      float eps_sq = 2 * variance * log_term * (1 / n0 + 1 / n1);
+      float d = older.mean - newer_mean;
+      if (d * d > fmax(eps_sq, floor_sq)) return true;
+    }
+    return false;
+  }
+  
+public:
+  uint32_t cuts = 0;
+  
+  void add(float value) {
+    push(value);
+    settle();
+  }
+  
+  void push(float value) {
+    // One sample without the cut test; settle() runs it
+    if (!has_shift) {
+      shift = value;
+      has_shift = true;
+    }
+    if (num_buckets == MAX_BUCKETS) dropOldest();
+    buckets[num_buckets++] = {1, value - shift, 0};
+    total++;
+    compress();
+    
+    // Cap the history at the configured feature window (plus transient)
+    if (total >= tunables.feature_window + settling) settling = 0;
+    while (num_buckets > 1 && total - buckets[0].count >= tunables.feature_window + settling) {
+      dropOldest();
+    }
+  }
+  
+  void settle() {
+    bool cut = false;
+    while (num_buckets > 1 && detectChange()) {
+      dropOldest();
+      cut = true;
+    }
+    if (cut) {
+      cuts++;
+      settling = total + (uint16_t)ceil(3.0 / tunables.filter_alpha);
+    }
+  }
+  
+  // Hold out everything so far, e.g. samples taken at another rate
+  void restart() { settling = total; }
+  
+  void reset() {
+    num_buckets = 0;
+    total = 0;
+    settling = 0;
+    has_shift = false;
+  }
+  
+  uint16_t length() const {
+    uint16_t n = (total > settling) ? total - settling : 0;
+    if (n < ADAPTIVE_WINDOW_MIN) n = ADAPTIVE_WINDOW_MIN;
+    if (n > tunables.feature_window) n = tunables.feature_window;
+    return n;
+  }
+  
+  int bucketCount() const { return num_buckets; }
+};
+
+AdaptiveWindow adaptive_window;
+
+uint16_t featureWindow() {
+#if ENABLE_ADAPTIVE_WINDOW
+  return adaptive_window.length();
+#else
+  return tunables.feature_window;
+#endif
+}
+
+// ============================================================================
+// CIRCULAR BUFFER MANAGEMENT
+// ============================================================================
+
+/*
+ * Incremental window accumulators
+ *
+ * SampleStats over the feature_window most recent filtered samples, x
+ * being the sample sequence number relative to origin. Each push adds the
+ * new sample and removes the one leaving the window in O(1); a run of
+ * samples from processBlock() is summarized on its own and merged in one
+ * step, its leaving samples removed the same way. Mean and m2 are
+ * centred, so millivolt-level variance survives in float without a shift.
+ * Every full extractFeatures() rebuilds them from the window, so rounding
+ * from the backward updates is bounded to the samples since then. min/max
+ * are only ever extended; the sequence numbers of the samples that set
+ * them tell when one has left the window and a rescan is due.
+ *
+ * Raw path
+ *
+ * The filter that steadies the features above also flattens transients
+ * shorter than a few samples. The unfiltered raw_value feeds a second,
+ * cheaper set: spikes (raw samples more than RAW_SPIKE_FACTOR noise
+ * floors off the filtered value, flagged once on entry and counted in and
+ * out of the window), the largest step between consecutive raw samples,
+ * and the raw range. The raw extremes and step are extended by each new
+ * sample rather than held, so they stay exact until the sample that set
+ * them leaves the window; only then, or for a shortened window, does
+ * extractFeatures() rescan the raw values. A few compares per sample.
+ *
+ * Gap accounting
+ *
+ * A sample arriving more than 1.5 acquisition periods after the previous
+ * one means the loop stalled and slots were missed. Runs of up to
+ * GAP_FILL_MAX missed slots are filled by linear interpolation between the
+ * two real samples, which keeps the window evenly spaced; longer gaps are
+ * left open and only counted. missed tracks the synthetic or lost slots
+ * inside the window, gaps the open gaps, which switch the trend to a
+ * timestamp-based regression.
+ */
+struct {
+  SampleStats moments;     // filtered samples in the window, x = seq - origin
+  uint32_t origin;
+  uint32_t pushed;         // monotonic sample sequence number
+  uint32_t min_seq, max_seq;
+  bool envelope_held;      // min/max valid since the last rebuild
+  uint16_t missed;         // interpolated or lost slots in the window
+  uint16_t gaps;           // open (unfilled) gaps in the window
+  uint16_t spikes;         // raw spikes in the window
+  float raw_min, raw_max;  // raw extremes since the last resync
+  float raw_step;          // largest raw step since the last resync
+  uint32_t raw_min_seq, raw_max_seq, raw_step_seq;
+} window_acc = {0};
+
+bool isRawSpike(float raw_value, float filtered_value) {
+  // Spike test on squares: no root per sample; noise floored at 2 codes
+  const float floor_var = (2 * 3.3f / 4095) * (2 * 3.3f / 4095);
+  float off = raw_value - filtered_value;
+  return off * off > RAW_SPIKE_FACTOR * RAW_SPIKE_FACTOR *
+                     fmax(noise_monitor.noiseVar(), floor_var);
+}
+
+void slideCounters(const SensorReading_t& in, const SensorReading_t* old,
+                   const SensorReading_t& prev) {
+  // Everything but the moments, by one sample; old is the reading leaving
+  // the window (NULL while it fills), prev the one before in
+  if (old) {
+    window_acc.missed -= old->missed;
+    if (old->missed > 0 && !old->is_interpolated) window_acc.gaps--;
+    if (old->is_spike) window_acc.spikes--;
+  }
+  window_acc.missed += in.missed;
+  if (in.missed > 0 && !in.is_interpolated) window_acc.gaps++;
+  
+  // Raw path: the new sample has sequence number pushed
+  uint32_t seq = window_acc.pushed++;
+  float raw_value = in.raw_value;
+  if (in.is_spike) window_acc.spikes++;
+  if (raw_value <= window_acc.raw_min) { window_acc.raw_min = raw_value; window_acc.raw_min_seq = seq; }
+  if (raw_value >= window_acc.raw_max) { window_acc.raw_max = raw_value; window_acc.raw_max_seq = seq; }
+  float step = prev.is_valid ? fabsf(raw_value - prev.raw_value) : 0;
+  if (step >= window_acc.raw_step) { window_acc.raw_step = step; window_acc.raw_step_seq = seq; }
+}
+
+void rebaseWindowOrigin() {
+  // Keep x small enough for float; the moments are shift-invariant in x
+  if (window_acc.pushed - window_acc.origin < 4096) return;
+  window_acc.origin += 2048;
+  window_acc.moments.x_mean -= 2048;
+}
+
+void appendReading(float raw_value, float filtered_value, uint32_t timestamp,
+                   uint8_t missed, bool interpolated) {
+  SensorReading_t reading;
+  reading.raw_value = raw_value;
+  reading.filtered_value = filtered_value;
+  reading.timestamp = timestamp;
+  reading.missed = missed;
+  reading.is_interpolated = interpolated;
+  reading.is_spike = !interpolated && isRawSpike(raw_value, filtered_value);
+  reading.is_valid = true;
+  
+  // Slide the window before the oldest slot is overwritten
+  rebaseWindowOrigin();
+  SampleStats& moments = window_acc.moments;
+  uint32_t seq = window_acc.pushed;
+  if (moments.count == 0 || filtered_value <= moments.min_val) window_acc.min_seq = seq;
+  if (moments.count == 0 || filtered_value >= moments.max_val) window_acc.max_seq = seq;
+  moments.add((float)(seq - window_acc.origin), filtered_value);
+  const SensorReading_t* old = NULL;
+  if (moments.count > tunables.feature_window) {
+    int oldest = buffer_index - tunables.feature_window;
+    if (oldest < 0) oldest += BUFFER_SIZE;
+    old = &sensor_buffer[oldest];
+    moments.remove((float)(seq - tunables.feature_window - window_acc.origin), old->filtered_value);
+  }
+  slideCounters(reading, old, sensor_buffer[(buffer_index - 1 + BUFFER_SIZE) % BUFFER_SIZE]);
+#if ENABLE_ADAPTIVE_WINDOW
+  adaptive_window.add(raw_value);
+#endif
+  
+  sensor_buffer[buffer_index] = reading;
+  if (++buffer_index == BUFFER_SIZE) buffer_index = 0;
+  sensor_samples_collected++;
+}
+
+void appendRun(const SensorReading_t* run, int n) {
+  // n consecutive readings in one sweep: the run and the samples it
+  // pushes out of the window are summarized separately and applied to
+  // the moments with one merge and one remove, then the run is copied
+  // into the ring in at most two pieces
+  uint16_t window = tunables.feature_window;
+  rebaseWindowOrigin();
+  uint32_t filled = window_acc.moments.count;
+  SampleStats in = {0}, out = {0};
+  uint32_t min_seq = 0, max_seq = 0;
+  for (int k = 0; k < n; k++) {
+    uint32_t seq = window_acc.pushed;
+    float y = run[k].filtered_value;
+    if (in.count == 0 || y <= in.min_val) min_seq = seq;
+    if (in.count == 0 || y >= in.max_val) max_seq = seq;
+    in.add((float)(seq - window_acc.origin), y);
+    
+    const SensorReading_t* old = NULL;
+    if (filled + k >= window) {
+      if (k >= window) {
+        old = &run[k - window];
+      } else {
+        int oldest = buffer_index + k - window;
+        if (oldest < 0) oldest += BUFFER_SIZE;
+        if (oldest >= BUFFER_SIZE) oldest -= BUFFER_SIZE;
+        old = &sensor_buffer[oldest];
+      }
+      out.add((float)(seq - window - window_acc.origin), old->filtered_value);
+    }
+    slideCounters(run[k], old, k ? run[k - 1] : sensor_buffer[(buffer_index - 1 + BUFFER_SIZE) % BUFFER_SIZE]);
+#if ENABLE_ADAPTIVE_WINDOW
+    adaptive_window.push(run[k].raw_value);
+#endif
+  }
+#if ENABLE_ADAPTIVE_WINDOW
+  // One cut test for the run: its length is only read at the cycle ending it
+  if (n > 0) adaptive_window.settle();
+#endif
+  
+  SampleStats& moments = window_acc.moments;
+  if (n > 0) {
+    if (moments.count == 0 || in.min_val <= moments.min_val) window_acc.min_seq = min_seq;
+    if (moments.count == 0 || in.max_val >= moments.max_val) window_acc.max_seq = max_seq;
+  }
+  moments.merge(in);
+  moments.remove(out);
+  
+  int first = (BUFFER_SIZE - buffer_index < n) ? BUFFER_SIZE - buffer_index : n;
+  memcpy(&sensor_buffer[buffer_index], run, first * sizeof(SensorReading_t));
+  memcpy(&sensor_buffer[0], run + first, (n - first) * sizeof(SensorReading_t));
+  buffer_index += n;
+  if (buffer_index >= BUFFER_SIZE) buffer_index -= BUFFER_SIZE;
+  sensor_samples_collected += n;
+}
+
+void pushSensorReading(float raw_value, float filtered_value, uint16_t period_ms, uint32_t now) {
+  SensorReading_t last = sensor_buffer[(buffer_index - 1 + BUFFER_SIZE) % BUFFER_SIZE];
+  uint32_t missed = 0;
+  
+  // Late sample: the loop stalled and acquisition slots were lost
+  if (last.is_valid && period_ms > 0) {
+    uint32_t elapsed = now - last.timestamp;
+    if (elapsed * 2 > period_ms * 3u) {
+      missed = (elapsed + period_ms / 2) / period_ms - 1;
+      metrics.sample_gaps++;
+      metrics.samples_missed += missed;
+    }
+  }
+  
+#if ENABLE_GAP_FILL
+  if (missed > 0 && missed <= GAP_FILL_MAX) {
+    for (uint32_t k = 1; k <= missed; k++) {
+      float f = (float)k / (missed + 1);
+      appendReading(last.raw_value + f * (raw_value - last.raw_value),
+                    last.filtered_value + f * (filtered_value - last.filtered_value),
+                    last.timestamp + (uint32_t)(f * (now - last.timestamp)), 1, true);
+    }
+    missed = 0;
+  }
+#endif
+  
+  appendReading(raw_value, filtered_value, now, missed > 255 ? 255 : missed, false);
+}
+
+float trendTimeScale(int valid_count) {
+  /*
+   * Regression runs over sample indices; rescale the slope to volts per
+   * nominal SAMPLE_PERIOD_MS so trend keeps its meaning across rate changes
+   */
+  if (valid_count < 2) return 1.0;
+  int newest = (buffer_index - 1 + BUFFER_SIZE) % BUFFER_SIZE;
+  int oldest = (buffer_index - valid_count + BUFFER_SIZE) % BUFFER_SIZE;
+  uint32_t span_ms = sensor_buffer[newest].timestamp - sensor_buffer[oldest].timestamp;
+  if (span_ms == 0) return 1.0;
+  return (float)SAMPLE_PERIOD_MS * (valid_count - 1) / span_ms;
+}
+
+void flushSensorWindow() {
+  // Drop every buffered sample, e.g. after an input fault left it stale
+  for (int i = 0; i < BUFFER_SIZE; i++) {
+    sensor_buffer[i].is_valid = false;
+  }
+  window_acc.moments = SampleStats();
+  window_acc.missed = window_acc.gaps = 0;
+  window_acc.envelope_held = false;
+  window_acc.spikes = 0;
+  window_acc.raw_min = FLT_MAX;
+  window_acc.raw_max = -FLT_MAX;
+  window_acc.raw_step = 0;
+  sensor_filter.reset();
+  adaptive_window.reset();
+  envelope_demod.restart();
+  ar_residual.restart();
+}
+
+int getValidSamplesCount() {
+  int count = 0;
+  for (int i = 0; i < BUFFER_SIZE; i++) {
+    if (sensor_buffer[i].is_valid) count++;
+  }
+  return count;
+}
+
+bool rawAccumulatorFeatures(Features_t& features) {
+  // Raw path over the full feature_window, valid while the samples that
+  // set the extremes are inside it (a step also needs the one before it)
+  uint32_t oldest_seq = window_acc.pushed - tunables.feature_window;
+  if (window_acc.moments.count < tunables.feature_window ||
+      (int32_t)(window_acc.raw_min_seq - oldest_seq) < 0 ||
+      (int32_t)(window_acc.raw_max_seq - oldest_seq) < 0 ||
+      (window_acc.raw_step > 0 && (int32_t)(window_acc.raw_step_seq - oldest_seq) <= 0)) {
+    return false;
+  }
+  features.raw_range = window_acc.raw_max - window_acc.raw_min;
+  features.raw_step = window_acc.raw_step;
+  features.raw_spikes = window_acc.spikes;
+  return true;
+}
+
+void scanRawFeatures(Features_t& features, uint16_t window, int start_idx) {
+  // O(window) rescan; over the full window it also resyncs the accumulators
+  float raw_min = FLT_MAX, raw_max = -FLT_MAX, raw_step = 0, prev_raw = 0;
+  int min_pos = 0, max_pos = 0, step_pos = 0;
+  uint16_t spikes = 0;
+  bool have_prev = false;
+  for (int i = 0; i < window; i++) {
+    const SensorReading_t& r = sensor_buffer[(start_idx + i) % BUFFER_SIZE];
+    if (!r.is_valid) continue;
+    float step = have_prev ? fabsf(r.raw_value - prev_raw) : 0;
+    if (r.raw_value <= raw_min) { raw_min = r.raw_value; min_pos = i; }
+    if (r.raw_value >= raw_max) { raw_max = r.raw_value; max_pos = i; }
+    if (step >= raw_step) { raw_step = step; step_pos = i; }
+    prev_raw = r.raw_value;
+    have_prev = true;
+    spikes += r.is_spike;
+  }
+  features.raw_range = have_prev ? raw_max - raw_min : 0;
+  features.raw_step = raw_step;
+  features.raw_spikes = spikes;
+  
+  if (window < tunables.feature_window) return;
+  window_acc.spikes = spikes;
+  window_acc.raw_min = raw_min;
+  window_acc.raw_max = raw_max;
+  window_acc.raw_step = raw_step;
+  window_acc.raw_min_seq = window_acc.pushed - window + min_pos;
+  window_acc.raw_max_seq = window_acc.pushed - window + max_pos;
+  window_acc.raw_step_seq = window_acc.pushed - window + step_pos;
+}
+
+// ============================================================================
+// FEATURE EXTRACTION: STATISTICAL MOMENTS
+// ============================================================================
+
+/*
+ * Robust trend: sampled Theil-Sen estimator
+ *
+ * The least-squares slope gives the window ends the most leverage, so one
+ * spike entering or leaving the window swings it hard. Theil-Sen takes
+ * the median of the slopes between sample pairs instead, which ignores up
+ * to ~29% contaminated samples. All n(n-1)/2 pairs is quadratic, so above
+ * ROBUST_TREND_PAIRS pairs a fixed pseudo-random subset is used; the seed
+ * is the same every call, so an unchanged window gives the same trend.
+ * Slopes use timestamps, so gaps and rate changes need no extra handling.
+ * Cost: O(window + ROBUST_TREND_PAIRS) per call, median by quickselect.
+ */
+
+static float selectKth(float* values, int n, int k) {
+  // Hoare quickselect, in place; returns the k-th smallest value
+  int lo = 0, hi = n - 1;
+  while (lo < hi) {
+    float pivot = values[(lo + hi) / 2];
+    int i = lo, j = hi;
+    while (i <= j) {
+      while (values[i] < pivot) i++;
+      while (values[j] > pivot) j--;
+      if (i <= j) {
+        float tmp = values[i]; values[i] = values[j]; values[j] = tmp;
+        i++; j--;
+      }
+    }
+    if (k <= j) hi = j;
+    else if (k >= i) lo = i;
+    else break;
+  }
+  return values[k];
+}
+
+float theilSenTrend(uint16_t window) {
+  static float t[BUFFER_SIZE], y[BUFFER_SIZE];
+  static float slopes[ROBUST_TREND_PAIRS];
+  
+  int start_idx = (buffer_index - window + BUFFER_SIZE) % BUFFER_SIZE;
+  const SensorReading_t& newest = sensor_buffer[(buffer_index - 1 + BUFFER_SIZE) % BUFFER_SIZE];
+  int n = 0;
+  for (int i = 0; i < window; i++) {
+    int idx = (start_idx + i) % BUFFER_SIZE;
+    if (!sensor_buffer[idx].is_valid) continue;
+    // Time in nominal periods before the newest sample, so the slope is
+    // in volts per SAMPLE_PERIOD_MS like the least-squares trend
+    t[n] = (int32_t)(sensor_buffer[idx].timestamp - newest.timestamp) * (1.0f / SAMPLE_PERIOD_MS);
+    y[n] = sensor_buffer[idx].filtered_value - newest.filtered_value;
+    n++;
+  }
+  if (n < 2) return 0;
+  
+  int count = 0;
+  if (n * (n - 1) / 2 <= ROBUST_TREND_PAIRS) {
+    for (int i = 0; i < n; i++) {
+      for (int j = i + 1; j < n; j++) {
+        if (t[j] > t[i]) slopes[count++] = (y[j] - y[i]) / (t[j] - t[i]);
+      }
+    }
+  } else {
+    uint32_t state = 0x9E3779B9u;
+    for (int k = 0; k < ROBUST_TREND_PAIRS; k++) {
+      state = state * 1664525u + 1013904223u;
+      int i = (state >> 8) % n;
+      state = state * 1664525u + 1013904223u;
+      int j = (i + 1 + (state >> 8) % (n - 1)) % n;  // any sample but i
+      if (t[j] != t[i]) slopes[count++] = (y[j] - y[i]) / (t[j] - t[i]);
+    }
+  }
+  if (count == 0) return 0;
+  
+  float upper = selectKth(slopes, count, count / 2);
+  if (count % 2 == 1) return upper;
+  // Even count: the lower middle is the largest value left of the upper one
+  float lower = slopes[0];
+  for (int i = 1; i < count / 2; i++) {
+    if (slopes[i] > lower) lower = slopes[i];
+  }
+  return (lower + upper) * 0.5f;
+}
+
+Features_t extractFeatures() {
+  Features_t features = {0};
+  
+  // Collect statistics from the most recent (effective) window of samples,
+  // x = position in the window
+  uint16_t window = featureWindow();
+  int start_idx = (buffer_index - window + BUFFER_SIZE) % BUFFER_SIZE;
+  
+  SampleStats stats = {0};
+  int min_pos = 0, max_pos = 0;
+  uint16_t missed = 0, gaps = 0;
+  
+  for (int i = 0; i < window; i++) {
+    int idx = (start_idx + i) % BUFFER_SIZE;
+    if (sensor_buffer[idx].is_valid) {
+      float val = sensor_buffer[idx].filtered_value;
+      // Latest occurrence of each extreme stays in the window longest
+      if (stats.count == 0 || val <= stats.min_val) min_pos = i;
+      if (stats.count == 0 || val >= stats.max_val) max_pos = i;
+      stats.add(i, val);
+      missed += sensor_buffer[idx].missed;
+      if (sensor_buffer[idx].missed > 0 && !sensor_buffer[idx].is_interpolated) gaps++;
+    }
+  }
+  
+  if (stats.count == 0) return features;
+  int valid_count = stats.count;
+  
+  // Mean
+  features.mean = stats.mean;
+  
+  // Standard Deviation
+  float variance = stats.variance();
+  features.std_dev = mathSqrt(variance, FAST_MATH_FEATURES);
+  
+  // Min/Max Range
+  features.min_val = stats.min_val;
+  features.max_val = stats.max_val;
+  
+  // RMS (Root Mean Square) - effective value for signals
+  features.rms = mathSqrt(variance + features.mean * features.mean, FAST_MATH_FEATURES);
+  
+  // Envelope spectrum: maintained per sample, only read out here
+  for (int b = 0; b < ENVELOPE_BANDS; b++) features.envelope[b] = envelope_demod.bandAmplitude(b);
+  features.ar_residual = ar_residual.residualLevel();
+  
+  // Raw path: from its accumulators unless they are stale
+  if (window < tunables.feature_window || !rawAccumulatorFeatures(features)) {
+    scanRawFeatures(features, window, start_idx);
+  }
+  
+  // Trend: least-squares slope over the window positions; open gaps
+  // regress on time (in nominal periods) instead
+#if ENABLE_ROBUST_TREND
+  features.trend = theilSenTrend(window);
+#else
+  features.trend = stats.slope() * trendTimeScale(valid_count);
+  if (gaps > 0) {
+    const SensorReading_t& newest = sensor_buffer[(buffer_index - 1 + BUFFER_SIZE) % BUFFER_SIZE];
+    SampleStats timed = {0};
+    for (int i = 0; i < window; i++) {
+      const SensorReading_t& r = sensor_buffer[(start_idx + i) % BUFFER_SIZE];
+      if (r.is_valid) {
+        timed.add((int32_t)(r.timestamp - newest.timestamp) * (1.0f / SAMPLE_PERIOD_MS), r.filtered_value);
+      }
+    }
+    if (timed.x_m2 > 0) features.trend = timed.slope();
+  }
+#endif
+  
+  // Rebuild the incremental accumulators from the window; they slide over
+  // the full feature_window, so a shortened window cannot
+  if (window < tunables.feature_window) {
+    window_acc.envelope_held = false;
+    return features;
+  }
+  window_acc.moments = stats;
+  window_acc.origin = window_acc.pushed - window;
+  window_acc.min_seq = window_acc.origin + min_pos;
+  window_acc.max_seq = window_acc.origin + max_pos;
+  window_acc.envelope_held = true;
+  window_acc.missed = missed;
+  window_acc.gaps = gaps;
+  
+  return features;
+}
+
+bool accumulatorFeatures(Features_t& features) {
+  /*
+   * O(1) features from the sliding accumulators. Only valid while the
+   * envelope holds and both extremes are still inside the window, since
+   * min/max only ever grow, and while the window has no open gap, since
+   * the trend here assumes even spacing. The adaptive window must be at
+   * full length, since the moments cover that.
+   */
+  const SampleStats& moments = window_acc.moments;
+  if (!window_acc.envelope_held || moments.count < 2 || window_acc.gaps > 0) return false;
+  if (featureWindow() < tunables.feature_window) return false;
+  uint32_t oldest_seq = window_acc.pushed - tunables.feature_window;
+  if ((int32_t)(window_acc.min_seq - oldest_seq) < 0 ||
+      (int32_t)(window_acc.max_seq - oldest_seq) < 0) {
+    return false;
+  }
+  if (!rawAccumulatorFeatures(features)) return false;
+  
+  float variance = moments.variance();
+  features.mean = moments.mean;
+  features.std_dev = mathSqrt(variance, FAST_MATH_FEATURES);
+  features.rms = mathSqrt(variance + features.mean * features.mean, FAST_MATH_FEATURES);
+  features.min_val = moments.min_val;
+  features.max_val = moments.max_val;
+  for (int b = 0; b < ENVELOPE_BANDS; b++) features.envelope[b] = envelope_demod.bandAmplitude(b);
+  features.ar_residual = ar_residual.residualLevel();
+  
+#if ENABLE_ROBUST_TREND
+  // A median has no sliding form: this path costs O(window) when robust
+  features.trend = theilSenTrend(tunables.feature_window);
+#else
+  features.trend = moments.slope() * trendTimeScale(moments.count);
+#endif
+  
+  return true;
+}
+
+// ============================================================================
+// MERGEABLE STATISTICS: PARTIAL RESULTS
+// ============================================================================
+
+SampleStats windowStats(int from, int to) {
+  // Filtered samples at positions [from, to) of the current feature
+  // window, x = position (SampleStats lives in sample_stats.h):
+  // windowStats(0, h) merged with windowStats(h, W) equals windowStats(0, W)
+  SampleStats stats = {0};
+  uint16_t window = featureWindow();
+  int start_idx = (buffer_index - window + BUFFER_SIZE) % BUFFER_SIZE;
+  for (int i = from; i < to && i < window; i++) {
+    const SensorReading_t& r = sensor_buffer[(start_idx + i) % BUFFER_SIZE];
+    if (r.is_valid) stats.add(i, r.filtered_value);
+  }
+  return stats;
+}
+
+// ============================================================================
+// FEATURE QUANTIZATION: INTEGER NORMALIZATION
+// ============================================================================
+
+/*
+ * Learned per-feature affine quantization
+ *
+ * At the end of learning every feature gets an offset and step so that the
+ * union of the learned ranges, padded by its own width on each side, maps
+ * onto the full quant_t code range. Features are normalized once per cycle;
+ * range checks and deviations then run on integers against reciprocal
+ * widths precomputed in Q16, which avoids per-cycle float division on
+ * FPU-less targets. Because the padding is at least one range width, a
+ * saturated code never changes a capped (>= 1.0) deviation term.
+ *
+ * The stability rule only needs max - min, which is quantized directly in
+ * mean-sized steps upward from QUANT_MIN (zero range): a saturated (large)
+ * range can never look abnormally stable.
+ *
+ * Error bound: each deviation term is off by at most 1.5 steps / range width
+ * (value and both bounds rounded by half a step) plus 2^-16 from the
+ * reciprocal; fitQuantization() reports the worst case over all modes.
+ * The fixed stability and trend rules can only flip for features within
+ * half a step of their thresholds.
+ */
+
+#if FEATURE_QUANT_BITS == 8
+typedef int8_t quant_t;
+#define QUANT_MIN (-128)
+#define QUANT_MAX 127
+#else
+typedef int16_t quant_t;
+#define QUANT_MIN (-32767 - 1)
+#define QUANT_MAX 32767
+#endif
+
+#define Q16_ONE 65536UL                // 1.0 in Q16 fixed point
+
+enum { Q_MEAN, Q_STD_DEV, Q_RMS, Q_RANGE, Q_TREND, Q_FEATURES };
+
+typedef struct {
+  quant_t v[Q_FEATURES];
+} QFeatures_t;
+
+class FeatureQuantizer {
+private:
+  float offset[Q_FEATURES];
+  float step[Q_FEATURES];
+  float inv_step[Q_FEATURES];
+  
+public:
+  FeatureQuantizer() {
+    for (int i = 0; i < Q_FEATURES; i++) {
+      offset[i] = 0;
+      step[i] = 1;
+      inv_step[i] = 1;
+    }
+  }
+  
+  void fit(int feature_idx, float lower, float upper) {
+    // Map [lower - width, upper + width] onto [QUANT_MIN, QUANT_MAX]
+    float width = fmax(upper - lower, 0.001f);
+    offset[feature_idx] = (lower + upper) * 0.5f;
+    step[feature_idx] = (3.0f * width) / (float)(QUANT_MAX - QUANT_MIN);
+    inv_step[feature_idx] = 1.0f / step[feature_idx];
+  }
+  
+  void fitFromZero(int feature_idx, float step_size) {
+    // Non-negative feature: zero maps to QUANT_MIN, not code 0, so all
+    // codes count up from it and only a large value saturates. Thresholds
+    // on it must go through quantize() too (see q_stable_range).
+    offset[feature_idx] = -step_size * QUANT_MIN;
+    step[feature_idx] = step_size;
+    inv_step[feature_idx] = 1.0f / step_size;
+  }
+  
+  float stepSize(int feature_idx) const { return step[feature_idx]; }
+  
+  quant_t quantize(int feature_idx, float value) const {
+    float q = (value - offset[feature_idx]) * inv_step[feature_idx];
+    q = fmax((float)QUANT_MIN, fmin((float)QUANT_MAX, q));
+    return (quant_t)lroundf(q);
+  }
+  
+  void apply(const Features_t& features, QFeatures_t& out) const {
+    out.v[Q_MEAN] = quantize(Q_MEAN, features.mean);
+    out.v[Q_STD_DEV] = quantize(Q_STD_DEV, features.std_dev);
+    out.v[Q_RMS] = quantize(Q_RMS, features.rms);
+    out.v[Q_RANGE] = quantize(Q_RANGE, features.max_val - features.min_val);
+    out.v[Q_TREND] = quantize(Q_TREND, features.trend);
+  }
+};
+
+FeatureQuantizer feature_quantizer;
+
+// ============================================================================
+// ISOLATION FOREST: LIGHTWEIGHT ANOMALY SCORING
+// ============================================================================
+
+/*
+ * Simplified Isolation Forest Implementation
+ * 
+ * Principle: Anomalies are isolated with fewer splits in a random forest
+ * of binary trees. This is a lightweight version suitable for embedded systems.
+ * 
+ * Instead of full trees, we use simple isolation rules based on feature ranges
+ */
+
+class LightweightIsolationForest {
+private:
+  struct SplitRule {
+    int feature_idx;      // 0=mean, 1=std_dev, 2=rms, 3=min, 4=max, 5=trend
+    float threshold;
+    float lower_bound, upper_bound;
+  };
+  
+  static const int NUM_TREES = 5;
+  static const int MAX_DEPTH = 8;
+  
+  SplitRule trees[NUM_TREES];
+  float feature_ranges[6][2];  // min/max for each feature
+  
+  // Integer scoring tables (built by buildQuantized)
+  int32_t q_lower[3], q_upper[3];   // mean, std_dev, rms bounds
+  uint32_t q_width[3];              // range widths in codes
+  uint32_t q_recip[3];              // Q16 reciprocal of range widths
+  int32_t q_trend_lower, q_trend_upper;
+  int32_t q_stable_range;           // max - min below this is anomalous stability
+  bool q_stable_check;
+  
+public:
+  LightweightIsolationForest() {
+    initializeFeatureRanges();
+  }
+  
+  void initializeFeatureRanges() {
+    // Safe default ranges
+    feature_ranges[0][0] = -100; feature_ranges[0][1] = 100;  // mean
+    feature_ranges[1][0] = 0;    feature_ranges[1][1] = 50;   // std_dev
+    feature_ranges[2][0] = 0;    feature_ranges[2][1] = 100;  // rms
+    feature_ranges[3][0] = -100; feature_ranges[3][1] = 100;  // min
+    feature_ranges[4][0] = -100; feature_ranges[4][1] = 100;  // max
+    feature_ranges[5][0] = -10;  feature_ranges[5][1] = 10;   // trend
+  }
+  
+  void seedFeatureRanges(const Features_t& features, float std_baseline) {
+    // Start a mode's ranges at its first window; the wide safe defaults
+    // would otherwise swallow every deviation of a learned mode
+    feature_ranges[0][0] = features.mean - std_baseline;
+    feature_ranges[0][1] = features.mean + std_baseline;
+    feature_ranges[1][0] = features.std_dev * 0.5;
+    feature_ranges[1][1] = features.std_dev * 1.5;
+    feature_ranges[2][0] = features.rms * 0.5;
+    feature_ranges[2][1] = features.rms * 1.5;
+  }
+  
+  void updateFeatureRanges(const Features_t& features, float mean_baseline, float std_baseline) {
+    // Dynamically expand ranges based on observed values during learning
+    feature_ranges[0][0] = fmin(feature_ranges[0][0], features.mean - std_baseline);
+    feature_ranges[0][1] = fmax(feature_ranges[0][1], features.mean + std_baseline);
+    
+    feature_ranges[1][0] = fmin(feature_ranges[1][0], features.std_dev * 0.5);
+    feature_ranges[1][1] = fmax(feature_ranges[1][1], features.std_dev * 1.5);
+    
+    feature_ranges[2][0] = fmin(feature_ranges[2][0], features.rms * 0.5);
+    feature_ranges[2][1] = fmax(feature_ranges[2][1], features.rms * 1.5);
+  }
+  
+  void scaleFeatureRanges(float factor) {
+    // Widen (>1) or narrow (<1) the scored ranges about their centres
+    for (int i = 0; i < 3; i++) {
+      float center = (feature_ranges[i][0] + feature_ranges[i][1]) * 0.5f;
+      float half = (feature_ranges[i][1] - feature_ranges[i][0]) * 0.5f * factor;
+      feature_ranges[i][0] = center - half;
+      feature_ranges[i][1] = center + half;
+    }
+  }
+  
+  void includeFeatureRange(int feature_idx, float lower, float upper) {
+    // Widen one feature's range to cover [lower, upper] (fleet priors)
+    feature_ranges[feature_idx][0] = fmin(feature_ranges[feature_idx][0], lower);
+    feature_ranges[feature_idx][1] = fmax(feature_ranges[feature_idx][1], upper);
+  }
+  
+  float rangeLower(int feature_idx) const { return feature_ranges[feature_idx][0]; }
+  float rangeUpper(int feature_idx) const { return feature_ranges[feature_idx][1]; }
+  
+  float buildQuantized(const FeatureQuantizer& quantizer, float baseline_std) {
+    // Returns the worst-case score error of this forest's deviation terms
+    float error_bound = 0;
+    
+    for (int i = 0; i < 3; i++) {
+      q_lower[i] = quantizer.quantize(i, feature_ranges[i][0]);
+      q_upper[i] = quantizer.quantize(i, feature_ranges[i][1]);
+      int32_t width_codes = q_upper[i] - q_lower[i];
+      q_width[i] = (width_codes > 1) ? (uint32_t)width_codes : 1;
+      q_recip[i] = (Q16_ONE + q_width[i] / 2) / q_width[i];
+      
+      float width = fmax(feature_ranges[i][1] - feature_ranges[i][0], 0.001f);
+      error_bound = fmax(error_bound, 1.5f * quantizer.stepSize(i) / width);
+    }
+    
+    q_trend_lower = quantizer.quantize(Q_TREND, -5.0);
+    q_trend_upper = quantizer.quantize(Q_TREND, 5.0);
+    refreshQuantizedBaseline(quantizer, baseline_std);
+    
+    return error_bound + 1.0f / Q16_ONE;
+  }
+  
+  void refreshQuantizedBaseline(const FeatureQuantizer& quantizer, float baseline_std) {
+    q_stable_range = quantizer.quantize(Q_RANGE, baseline_std * 2.0f * 0.1f);
+    q_stable_check = baseline_std > 0;
+  }
+  
+  uint32_t anomalyScoreQ(const QFeatures_t& q) const {
+    /*
+     * Integer mirror of anomalyScore(): same rules, score in Q16 [0, Q16_ONE]
+     */
+    uint32_t score = 0;
+    uint32_t violation_count = 0;
+    
+    for (int i = 0; i < 3; i++) {
+      int32_t value = q.v[i];
+      uint32_t deviation;
+      
+      if (value > q_upper[i]) {
+        deviation = (uint32_t)(value - q_upper[i]);
+      } else if (i == 0 && value < q_lower[i]) {
+        // Only the mean range is two-sided
+        deviation = (uint32_t)(q_lower[i] - value);
+      } else {
+        continue;
+      }
+      
+      score += (deviation >= q_width[i]) ? Q16_ONE : deviation * q_recip[i];
+      violation_count++;
+    }
+    
+    // Range compression detection (abnormally stable)
+    if (q_stable_check && q.v[Q_RANGE] < q_stable_range) {
+      score += 19661;  // 0.3 in Q16
+      violation_count++;
+    }
+    
+    // Extreme trend changes
+    if (q.v[Q_TREND] > q_trend_upper || q.v[Q_TREND] < q_trend_lower) {
+      score += 26214;  // 0.4 in Q16
+      violation_count++;
+    }
+    
+    if (violation_count > 0) {
+      score /= violation_count;
+    }
+    
+    return (score > Q16_ONE) ? Q16_ONE : score;
+  }
+  
+  float anomalyScore(const Features_t& features, float baseline_std) {
+    /*
+     * Anomaly Scoring Logic:
+     * - For each feature, calculate deviation from baseline ranges
+     * - Deviations beyond normal range increase anomaly score
+     * - Score normalized to [0, 1]
+     */
+    
+    float score = 0.0;
+    int violation_count = 0;
+    
+    // Deviation from mean range
+    if (features.mean < feature_ranges[0][0] || features.mean > feature_ranges[0][1]) {
+      float deviation = (features.mean < feature_ranges[0][0]) ?
+                        (feature_ranges[0][0] - features.mean) :
+                        (features.mean - feature_ranges[0][1]);
+      float range_width = feature_ranges[0][1] - feature_ranges[0][0];
+      score += fmin(1.0, deviation / range_width);
+      violation_count++;
+    }
+    
+    // Deviation from std_dev range
+    if (features.std_dev > feature_ranges[1][1]) {
+      float deviation = features.std_dev - feature_ranges[1][1];
+      float range_width = feature_ranges[1][1] - feature_ranges[1][0];
+      score += fmin(1.0, deviation / range_width);
+      violation_count++;
+    }
+    
+    // Deviation from RMS range
+    if (features.rms > feature_ranges[2][1]) {
+      float deviation = features.rms - feature_ranges[2][1];
+      float range_width = feature_ranges[2][1] - feature_ranges[2][0];
+      score += fmin(1.0, deviation / range_width);
+      violation_count++;
+    }
+    
+    // Range compression detection (abnormally stable)
+    // Expected range follows the AC spread; the RMS includes the DC level
+    float range = features.max_val - features.min_val;
+    float expected_range = baseline_std * 2.0;
+    if (range < expected_range * 0.1 && baseline_std > 0) {
+      score += 0.3;  // Anomalous stability
+      violation_count++;
+    }
+    
+    // Extreme trend changes
+    if (fabs(features.trend) > 5.0) {
+      score += 0.4;
+      violation_count++;
+    }
+    
+    // Normalize score
+    if (violation_count > 0) {
+      score = score / (violation_count * 1.0);
+    }
+    
+    return fmin(1.0, score);
+  }
+};
+
+// ============================================================================
+// OPERATING MODE CLUSTERING: PER-MODE BASELINES
+// ============================================================================
+
+/*
+ * Leader clustering of feature vectors
+ *
+ * Machines have several distinct normal states (idle, running, high load).
+ * A single baseline flags every switch between them, so each learned mode
+ * keeps its own baseline and isolation forest ranges. A feature vector
+ * further than MODE_LEADER_RADIUS from every mode spawns a new one while
+ * learning; afterwards, normal decisions slowly drag the matched mode's
+ * baseline along (background k-means step). Matching is O(k) per cycle.
+ */
+
+typedef struct {
+  float baseline_mean;
+  float baseline_std;
+  float baseline_rms;
+  uint32_t member_count;
+} OperatingMode_t;
+
+void refreshShadowBaseline(int mode, float baseline_std);
+
+class OperatingModeClusters {
+private:
+  OperatingMode_t modes[NUM_OPERATING_MODES];
+  LightweightIsolationForest forests[NUM_OPERATING_MODES];
+  int mode_count = 0;
+  
+  float distanceSq(const OperatingMode_t& mode, const Features_t& features) const {
+    float d_mean = features.mean - mode.baseline_mean;
+    float d_std = features.std_dev - mode.baseline_std;
+    return (d_mean * d_mean) + (d_std * d_std);
+  }
+  
+public:
+  OperatingModeClusters() {
+    reset();
+  }
+  
+  void reset() {
+    OperatingMode_t empty = {0, 0, 0, 0};
+    mode_count = 0;
+    for (int i = 0; i < NUM_OPERATING_MODES; i++) {
+      modes[i] = empty;
+      forests[i].initializeFeatureRanges();
+    }
+  }
+  
+  int count() const { return mode_count; }
+  const OperatingMode_t& mode(int idx) const { return modes[idx]; }
+  LightweightIsolationForest& forest(int idx) { return forests[idx]; }
+  
+  int nearestMode(const Features_t& features) const {
+    int best = -1;
+    float best_dist = FLT_MAX;
+    for (int i = 0; i < mode_count; i++) {
+      float dist = distanceSq(modes[i], features);
+      if (dist < best_dist) {
+        best_dist = dist;
+        best = i;
+      }
+    }
+    return best;
+  }
+  
+  void learn(const Features_t& features) {
+    int idx = nearestMode(features);
+    bool too_far = (idx < 0) ||
+                   (distanceSq(modes[idx], features) > MODE_LEADER_RADIUS * MODE_LEADER_RADIUS);
+    
+    if (too_far && mode_count < NUM_OPERATING_MODES) {
+      // Spawn a new mode led by this feature vector
+      idx = mode_count++;
+      modes[idx].baseline_mean = features.mean;
+      modes[idx].baseline_std = features.std_dev;
+      modes[idx].baseline_rms = features.rms;
+      modes[idx].member_count = 1;
+      forests[idx].seedFeatureRanges(features, features.std_dev);
+    } else {
+      // Running average update of the nearest mode
+      OperatingMode_t& m = modes[idx];
+      m.member_count++;
+      float w = 1.0 / m.member_count;
+      m.baseline_mean += w * (features.mean - m.baseline_mean);
+      m.baseline_std += w * (features.std_dev - m.baseline_std);
+      m.baseline_rms += w * (features.rms - m.baseline_rms);
+    }
+    
+    forests[idx].updateFeatureRanges(features, modes[idx].baseline_mean, modes[idx].baseline_std);
+  }
+  
+  int adopt(const float baseline[3], const float offsets[3][2]) {
+    // Merge a prior mode: widen the nearest learned mode within
+    // MODE_LEADER_RADIUS, or occupy a free slot (-1 if neither). Offsets
+    // place the mean / std_dev / rms ranges about the mode's baselines.
+    Features_t centre = {0};
+    centre.mean = baseline[0];
+    centre.std_dev = baseline[1];
+    centre.rms = baseline[2];
+    
+    int idx = nearestMode(centre);
+    if (idx < 0 || distanceSq(modes[idx], centre) > MODE_LEADER_RADIUS * MODE_LEADER_RADIUS) {
+      if (mode_count == NUM_OPERATING_MODES) return -1;
+      idx = mode_count++;
+      modes[idx].baseline_mean = centre.mean;
+      modes[idx].baseline_std = centre.std_dev;
+      modes[idx].baseline_rms = centre.rms;
+      modes[idx].member_count = 0;  // not seen locally
+      forests[idx].seedFeatureRanges(centre, centre.std_dev);
+    }
+    
+    const float local[3] = {modes[idx].baseline_mean, modes[idx].baseline_std,
+                            modes[idx].baseline_rms};
+    for (int f = 0; f < 3; f++) {
+      forests[idx].includeFeatureRange(f, local[f] + offsets[f][0], local[f] + offsets[f][1]);
+    }
+    return idx;
+  }
+  
+  void track(const Features_t& features, int idx) {
+    // Background drift of an already matched mode (normal decisions only)
+    if (idx < 0 || idx >= mode_count) return;
+    OperatingMode_t& m = modes[idx];
+    m.baseline_mean += MODE_TRACKING_RATE * (features.mean - m.baseline_mean);
+    m.baseline_std += MODE_TRACKING_RATE * (features.std_dev - m.baseline_std);
+    m.baseline_rms += MODE_TRACKING_RATE * (features.rms - m.baseline_rms);
+    forests[idx].refreshQuantizedBaseline(feature_quantizer, m.baseline_std);
+    refreshShadowBaseline(idx, m.baseline_std);  // Keep shadows like-for-like
+  }
+  
+  float fitQuantization() {
+    // Quantize each scored feature over the union of all modes' ranges
+    // (forest feature indices: 0=mean, 1=std_dev, 2=rms, 5=trend)
+    static const int range_idx[Q_FEATURES] = {0, 1, 2, -1, 5};
+    
+    for (int f = 0; f < Q_FEATURES; f++) {
+      if (range_idx[f] < 0) continue;
+      float lower = FLT_MAX, upper = -FLT_MAX;
+      for (int i = 0; i < mode_count; i++) {
+        lower = fmin(lower, forests[i].rangeLower(range_idx[f]));
+        upper = fmax(upper, forests[i].rangeUpper(range_idx[f]));
+      }
+      feature_quantizer.fit(f, lower, upper);
+    }
+    feature_quantizer.fitFromZero(Q_RANGE, feature_quantizer.stepSize(Q_MEAN));
+    
+    float error_bound = 0;
+    for (int i = 0; i < mode_count; i++) {
+      error_bound = fmax(error_bound,
+                         forests[i].buildQuantized(feature_quantizer, modes[i].baseline_std));
+    }
+    return error_bound;
+  }
+};
+
+OperatingModeClusters operating_modes;
+int active_mode = 0;
+float quantized_score_error = 0;  // Worst-case |anomalyScoreQ - anomalyScore|
+
+// ============================================================================
+// TRAINING SET: RESERVOIR SAMPLING
+// ============================================================================
+
+/*
+ * Fixed-capacity reservoir of feature vectors (Algorithm R)
+ *
+ * Keeps a uniform sample of every feature vector offered during learning
+ * and normal operation, in RESERVOIR_CAPACITY slots regardless of runtime.
+ * With RESERVOIR_RECENCY_FLOOR > 0 every vector is accepted with at least
+ * that probability, so older entries decay exponentially (recency bias).
+ * Features are stored as int16 at RESERVOIR_Q_SCALE steps per volt, half
+ * the RAM of Features_t. Model builders read them back through get().
+ */
+
+class FeatureReservoir {
+private:
+  int16_t samples[RESERVOIR_CAPACITY][6];  // mean, std_dev, rms, min, max, trend
+  uint16_t stored = 0;
+  uint32_t offered = 0;
+  uint32_t rng_state = 0x9E3779B9;
+  
+  uint32_t nextRandom() {
+    // xorshift32: deterministic and cheap on every target
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+  }
+  
+  static int16_t quantize(float value) {
+    float q = value * RESERVOIR_Q_SCALE;
+    q = fmax(-32768.0f, fmin(32767.0f, q));
+    return (int16_t)lroundf(q);
+  }
+  
+  static float dequantize(int16_t q) {
+    return q / RESERVOIR_Q_SCALE;
+  }
+  
+  void store(int slot, const Features_t& features) {
+    samples[slot][0] = quantize(features.mean);
+    samples[slot][1] = quantize(features.std_dev);
+    samples[slot][2] = quantize(features.rms);
+    samples[slot][3] = quantize(features.min_val);
+    samples[slot][4] = quantize(features.max_val);
+    samples[slot][5] = quantize(features.trend);
+  }
+  
+public:
+  void reset() {
+    stored = 0;
+    offered = 0;
+  }
+  
+  int size() const { return stored; }
+  uint32_t offeredCount() const { return offered; }
+  
+  void offer(const Features_t& features) {
+    offered++;
+    
+    if (stored < RESERVOIR_CAPACITY) {
+      store(stored++, features);
+      return;
+    }
+    
+    // Accept with probability max(k/n, floor), then evict a random slot
+    float accept = fmax((float)RESERVOIR_CAPACITY / offered, RESERVOIR_RECENCY_FLOOR);
+    if ((nextRandom() >> 8) * (1.0f / 16777216.0f) < accept) {
+      store(nextRandom() % RESERVOIR_CAPACITY, features);
+    }
+  }
+  
+  void merge(const FeatureReservoir& other) {
+    /*
+     * Reservoir of the union: each kept vector comes from this side with
+     * probability proportional to the vectors it has not yet given up,
+     * out of all offered (sampling without replacement). Uniform
+     * reservoirs merge into a uniform one in any grouping; with a recency
+     * floor the sides are weighted by their offered counts all the same.
+     */
+    int16_t merged[RESERVOIR_CAPACITY][6];
+    uint16_t pool_a[RESERVOIR_CAPACITY], pool_b[RESERVOIR_CAPACITY];
+    int left_in_a = stored, left_in_b = other.stored;
+    for (int i = 0; i < left_in_a; i++) pool_a[i] = i;
+    for (int i = 0; i < left_in_b; i++) pool_b[i] = i;
+    uint32_t unseen_a = offered, unseen_b = other.offered;
+    int kept = 0;
+    while (kept < RESERVOIR_CAPACITY && (left_in_a > 0 || left_in_b > 0)) {
+      bool from_a = left_in_b == 0 ||
+                    (left_in_a > 0 && nextRandom() % (unseen_a + unseen_b) < unseen_a);
+      // Take a random remaining slot of that side, swap the last one in
+      if (from_a) {
+        int pick = nextRandom() % left_in_a;
+        memcpy(merged[kept++], samples[pool_a[pick]], sizeof(merged[0]));
+        pool_a[pick] = pool_a[--left_in_a];
+        unseen_a--;
+      } else {
+        int pick = nextRandom() % left_in_b;
+        memcpy(merged[kept++], other.samples[pool_b[pick]], sizeof(merged[0]));
+        pool_b[pick] = pool_b[--left_in_b];
+        unseen_b--;
+      }
+    }
+    memcpy(samples, merged, kept * sizeof(merged[0]));
+    stored = kept;
+    offered += other.offered;
+  }
+  
+  Features_t get(int idx) const {
+    Features_t features;
+    features.mean = dequantize(samples[idx][0]);
+    features.std_dev = dequantize(samples[idx][1]);
+    features.rms = dequantize(samples[idx][2]);
+    features.min_val = dequantize(samples[idx][3]);
+    features.max_val = dequantize(samples[idx][4]);
+    features.trend = dequantize(samples[idx][5]);
+    return features;
+  }
+};
+
+FeatureReservoir training_reservoir;
+
+// ============================================================================
+// STREAMING HISTOGRAMS: SCORE & FEATURE DISTRIBUTIONS
+// ============================================================================
+
+/*
+ * Fixed-memory log-linear (HDR-style) histograms
+ *
+ * Each octave [2^e, 2^(e+1)) between 2^HIST_MIN_EXP and 2^HIST_MAX_EXP is
+ * split into 2^HIST_SUB_BUCKET_BITS linear sub-buckets, so every bucket has
+ * the same relative width. The bucket index comes from frexpf() in O(1).
+ * The layout is fixed at compile time and printed with every dump, so
+ * histograms from many devices or dumps merge by adding counts per index.
+ *
+ * Buckets hold magnitudes, not signed values. mean, min and max are
+ * recorded as |value|: they are levels of the 0..3.3 V ADC input, so the
+ * magnitude is the value itself, and a shift down shows as lower buckets,
+ * not as a mirrored one. Only trend changes sign in normal operation; it
+ * is kept as two magnitude histograms, trend+ and trend-.
+ *
+ * Dump format (one line per histogram, only non-empty buckets):
+ *   HIST-BEGIN t=<ms> thr=<adaptive_threshold> layout=<bits>,<min_exp>,<max_exp>
+ *   HIST <name> n=<total> <index>:<count> ...
+ *   HIST-END
+ */
+
+class LogLinearHistogram {
+public:
+  static const int SUB_BUCKETS = 1 << HIST_SUB_BUCKET_BITS;
+  static const int NUM_BUCKETS = 1 + (HIST_MAX_EXP - HIST_MIN_EXP) * SUB_BUCKETS;
+  
+private:
+  uint32_t counts[NUM_BUCKETS];
+  uint32_t total;
+  
+public:
+  LogLinearHistogram() { reset(); }
+  
+  static int bucketIndex(float magnitude) {
+    // Bucket 0 holds everything below 2^HIST_MIN_EXP (including zero)
+    if (!(magnitude >= ldexpf(1.0f, HIST_MIN_EXP))) return 0;
+    int exponent;
+    float mantissa = frexpf(magnitude, &exponent);  // magnitude = m * 2^e, m in [0.5, 1)
+    int octave = exponent - 1 - HIST_MIN_EXP;
+    if (octave >= HIST_MAX_EXP - HIST_MIN_EXP) return NUM_BUCKETS - 1;
+    int sub = (int)((mantissa * 2.0f - 1.0f) * SUB_BUCKETS);
+    return 1 + octave * SUB_BUCKETS + sub;
+  }
+  
+  static float bucketLowerBound(int idx) {
+    if (idx <= 0) return 0;
+    int octave = (idx - 1) / SUB_BUCKETS;
+    int sub = (idx - 1) % SUB_BUCKETS;
+    return ldexpf(1.0f + (float)sub / SUB_BUCKETS, octave + HIST_MIN_EXP);
+  }
+  
+  void reset() {
+    memset(counts, 0, sizeof(counts));
+    total = 0;
+  }
+  
+  void record(float magnitude) {
+    counts[bucketIndex(magnitude)]++;
+    total++;
+  }
+  
+  void add(int idx, uint32_t count) {
+    counts[idx] += count;
+    total += count;
+  }
+  
+  void merge(const LogLinearHistogram& other) {
+    for (int i = 0; i < NUM_BUCKETS; i++) counts[i] += other.counts[i];
+    total += other.total;
+  }
+  
+  uint32_t count(int idx) const { return counts[idx]; }
+  uint32_t totalCount() const { return total; }
+  
+  float quantile(float q) const {
+    // Lower bound of the bucket holding the q-th fraction of samples
+    uint32_t rank = (uint32_t)(q * total);
+    uint32_t seen = 0;
+    for (int i = 0; i < NUM_BUCKETS; i++) {
+      seen += counts[i];
+      if (seen > rank) return bucketLowerBound(i);
+    }
+    return bucketLowerBound(NUM_BUCKETS - 1);
+  }
+  
+  void dump(const char* name) const {
+    Serial.printf("HIST %s n=%u", name, total);
+    for (int i = 0; i < NUM_BUCKETS; i++) {
+      if (counts[i]) Serial.printf(" %d:%u", i, counts[i]);
+    }
+    Serial.println();
+  }
+};
+
+class FeatureHistograms {
+private:
+  // Magnitude histograms; trend is signed, so positive and negative slopes
+  // keep separate magnitudes (see above for the levels)
+  LogLinearHistogram score, mean, std_dev, rms, min_val, max_val, trend_up, trend_down;
+  
+public:
+  void reset() {
+    score.reset(); mean.reset(); std_dev.reset(); rms.reset();
+    min_val.reset(); max_val.reset(); trend_up.reset(); trend_down.reset();
+  }
+  
+  void merge(const FeatureHistograms& other) {
+    score.merge(other.score); mean.merge(other.mean); std_dev.merge(other.std_dev);
+    rms.merge(other.rms); min_val.merge(other.min_val); max_val.merge(other.max_val);
+    trend_up.merge(other.trend_up); trend_down.merge(other.trend_down);
+  }
+  
+  void record(float anomaly_score, const Features_t& features) {
+    score.record(anomaly_score);
+    mean.record(fabs(features.mean));
+    std_dev.record(features.std_dev);
+    rms.record(features.rms);
+    min_val.record(fabs(features.min_val));
+    max_val.record(fabs(features.max_val));
+    if (features.trend >= 0) trend_up.record(features.trend);
+    else trend_down.record(-features.trend);
+  }
+  
+  void dump() const {
+    // Stamped with the last feature cycle the histograms include
+    Serial.printf("HIST-BEGIN t=%u thr=%.4f layout=%d,%d,%d\n", last_feature_update,
+                  anomaly_model.adaptive_threshold,
+                  HIST_SUB_BUCKET_BITS, HIST_MIN_EXP, HIST_MAX_EXP);
+    score.dump("score");
+    mean.dump("mean");
+    std_dev.dump("std_dev");
+    rms.dump("rms");
+    min_val.dump("min");
+    max_val.dump("max");
+    trend_up.dump("trend+");
+    trend_down.dump("trend-");
+    Serial.println("HIST-END");
+  }
+};
+
+FeatureHistograms feature_histograms;
+
+// ============================================================================
+// FLEET PRIOR: MODEL EXPORT & IMPORT
+// ============================================================================
+
+/*
+ * Models shared across identical sensors
+ *
+ * Each device otherwise learns alone from LEARNING_DURATION_MS of its own
+ * data, while many devices of the same SENSOR_TYPE already hold good
+ * models. The "model" command exports the learned model; the host tool
+ * fleet_prior.cpp reduces exports from many devices to robust per-type
+ * medians and emits a compact prior blob as "prior" command lines.
+ *
+ * While a prior is loaded, learning runs for PRIOR_LEARNING_MS and its
+ * result is merged with the prior when it completes:
+ * - A prior mode near a learned one widens that mode's ranges
+ * - A prior mode not seen locally is adopted while mode slots are free
+ * - The adaptive threshold starts no lower than the fleet median
+ * Prior ranges are offsets from the mode baselines, so device-to-device
+ * level differences do not widen them. The blob is checked for magic,
+ * version, sensor type hash and CRC-32; it is held in RAM only and is
+ * reloaded by the commissioning script after power-up.
+ *
+ * Dump format (ranges: mean, std_dev, rms):
+ *   MODEL-BEGIN type=<SENSOR_TYPE> modes=<n> thr=<adaptive_threshold>
+ *   MODE <i> n=<windows> mean=<V> std=<V> rms=<V> r=<lo>,<hi>,<lo>,<hi>,<lo>,<hi>
+ *   MODEL-END
+ */
+
+static uint32_t crc32(const void* data, size_t len) {
+  // CRC-32 (IEEE, reflected), bitwise: small and only run on records
+  const uint8_t* bytes = (const uint8_t*)data;
+  uint32_t crc = 0xFFFFFFFFu;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= bytes[i];
+    for (int b = 0; b < 8; b++) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+  }
+  return ~crc;
+}
+
+static uint32_t fnv1a(const char* text) {
+  uint32_t hash = 2166136261u;
+  while (*text) hash = (hash ^ (uint8_t)*text++) * 16777619u;
+  return hash;
+}
+
+void exportModel() {
+  Serial.printf("MODEL-BEGIN type=%s modes=%d thr=%.4f\n", SENSOR_TYPE,
+                operating_modes.count(), anomaly_model.adaptive_threshold);
+  for (int i = 0; i < operating_modes.count(); i++) {
+    const OperatingMode_t& mode = operating_modes.mode(i);
+    LightweightIsolationForest& forest = operating_modes.forest(i);
+    Serial.printf("MODE %d n=%u mean=%.5f std=%.5f rms=%.5f r=", i, mode.member_count,
+                  mode.baseline_mean, mode.baseline_std, mode.baseline_rms);
+    for (int f = 0; f < 3; f++) {
+      Serial.printf("%s%.5f,%.5f", f ? "," : "", forest.rangeLower(f), forest.rangeUpper(f));
+    }
+    Serial.println();
+  }
+  Serial.println("MODEL-END");
+}
+
+typedef struct {
+  float baseline[3];       // mean, std_dev, rms (V)
+  float offsets[3][2];     // range bounds relative to each baseline
+} PriorMode_t;
+
+typedef struct {
+  uint32_t magic;
+  uint16_t version;
+  uint8_t mode_count;
+  uint8_t reserved;
+  uint32_t type_hash;      // FNV-1a of SENSOR_TYPE
+  uint16_t devices;        // models the prior was reduced from
+  uint16_t reserved2;
+  float threshold;         // fleet median adaptive threshold
+  PriorMode_t modes[NUM_OPERATING_MODES];
+  uint32_t crc;
+} FleetPrior_t;
+
+#define PRIOR_MAGIC 0x52495250u        // "PRIR"
+#define PRIOR_VERSION 1
+
+class FleetPrior {
+private:
+  FleetPrior_t prior;
+  FleetPrior_t staged;     // blob being received over serial
+  uint16_t staged_bytes = 0;
+  bool staging = false;
+  bool loaded = false;
+  
+  static int hexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+  }
+  
+public:
+  static void seal(FleetPrior_t& p, const char* type) {
+    p.magic = PRIOR_MAGIC;
+    p.version = PRIOR_VERSION;
+    p.type_hash = fnv1a(type);
+    p.crc = crc32(&p, offsetof(FleetPrior_t, crc));
+  }
+  
+  static const char* check(const FleetPrior_t& p) {
+    // NULL if the blob is usable on this build, else why not
+    if (p.magic != PRIOR_MAGIC || p.version != PRIOR_VERSION) return "bad magic or version";
+    if (p.crc != crc32(&p, offsetof(FleetPrior_t, crc))) return "CRC mismatch";
+    if (p.type_hash != fnv1a(SENSOR_TYPE)) return "sensor type mismatch";
+    if (p.mode_count < 1 || p.mode_count > NUM_OPERATING_MODES) return "bad mode count";
+    return NULL;
+  }
+  
+  bool valid() const { return loaded; }
+  uint16_t stagedBytes() const { return staged_bytes; }
+  const FleetPrior_t& blob() const { return prior; }
+  void clear() { loaded = false; }
+  
+  // Chunked transfer (serial lines are short): begin, feed hex, commit
+  void begin() {
+    memset(&staged, 0, sizeof(staged));
+    staged_bytes = 0;
+    staging = true;
+  }
+  
+  bool feed(const char* hex) {
+    for (; staging && *hex; hex += 2) {
+      int hi = hexDigit(hex[0]);
+      int lo = hex[1] ? hexDigit(hex[1]) : -1;
+      if (hi < 0 || lo < 0 || staged_bytes >= sizeof(staged)) staging = false;
+      else ((uint8_t*)&staged)[staged_bytes++] = (uint8_t)((hi << 4) | lo);
+    }
+    return staging;
+  }
+  
+  const char* commit() {
+    if (!staging) return "no transfer in progress";
+    staging = false;
+    if (staged_bytes != sizeof(staged)) return "incomplete blob";
+    const char* error = check(staged);
+    if (error == NULL) {
+      prior = staged;
+      loaded = true;
+    }
+    return error;
+  }
+  
+  void apply() {
+    // Merge into the freshly learned model (completeLearningPhase)
+    if (!loaded) return;
+    int adopted = 0;
+    for (int i = 0; i < prior.mode_count; i++) {
+      if (operating_modes.adopt(prior.modes[i].baseline, prior.modes[i].offsets) >= 0) adopted++;
+    }
+    anomaly_model.adaptive_threshold = fmax(anomaly_model.adaptive_threshold, prior.threshold);
+    Serial.printf("Fleet Prior: %d of %d modes merged | %u devices | threshold >= %.3f\n",
+                  adopted, prior.mode_count, prior.devices, prior.threshold);
+  }
+  
+  void print() const {
+    if (!loaded) {
+      Serial.printf("OK prior none (type %s)\n", SENSOR_TYPE);
+      return;
+    }
+    Serial.printf("OK prior type=%s devices=%u modes=%u thr=%.4f\n", SENSOR_TYPE,
+                  prior.devices, prior.mode_count, prior.threshold);
+    for (int i = 0; i < prior.mode_count; i++) {
+      const PriorMode_t& m = prior.modes[i];
+      Serial.printf("  mode %d: mean %.4f std %.4f rms %.4f\n", i,
+                    m.baseline[0], m.baseline[1], m.baseline[2]);
+    }
+  }
+};
+
+FleetPrior fleet_prior;
+
+uint32_t learningDurationMs() {
+#if ENABLE_FLEET_PRIOR
+  if (fleet_prior.valid()) return PRIOR_LEARNING_MS;
+#endif
+  return LEARNING_DURATION_MS;
+}
+
+// ============================================================================
+// LEARNING PHASE: BASELINE ESTABLISHMENT
+// ============================================================================
+
+void abortSelfTest(const char* why);
+void noteJournalRelearn();
+
+void enterLearningPhase() {
+#if ENABLE_SELF_TEST
+  abortSelfTest("relearn");
+#endif
+  noteJournalRelearn();
+  learning_phase_active = true;
+  learning_start_time = millis();
+  sensor_samples_collected = 0;
+  operating_modes.reset();
+  active_mode = 0;
+  training_reservoir.reset();
+  noise_monitor.clearBaseline();
+  envelope_demod.clearBaseline();
+  ar_residual.clearBaseline();
+  
+  Serial.println("\n========== LEARNING PHASE STARTED ==========");
+  Serial.printf("Duration: %u seconds%s\n", learningDurationMs() / 1000,
+                (learningDurationMs() != LEARNING_DURATION_MS) ? " (fleet prior loaded)" : "");
+  Serial.println("Establishing baseline normal behavior...");
+  Serial.println("===========================================\n");
+}
+
+void completeLearningPhase() {
+  if (sensor_samples_collected < 30) {
+    Serial.println("[WARNING] Insufficient samples during learning phase");
+    return;
+  }
+  
+  learning_phase_active = false;
+  
+  // Extract features after learning period
+  current_features = extractFeatures();
+  
+  // Establish baseline thresholds
+  anomaly_model.baseline_mean = current_features.mean;
+  anomaly_model.baseline_std = current_features.std_dev;
+  anomaly_model.baseline_rms = current_features.rms;
+  
+  // Adaptive threshold: 2 standard deviations from baseline + margin
+  anomaly_model.adaptive_threshold = 
+    tunables.anomaly_threshold + (current_features.std_dev * 0.15);
+  
+  // Seed a single operating mode if no full window was clustered
+  if (operating_modes.count() == 0) {
+    operating_modes.learn(current_features);
+  }
+  
+#if ENABLE_FLEET_PRIOR
+  fleet_prior.apply();
+#endif
+  
+#if ENABLE_QUANTIZED_SCORING
+  quantized_score_error = operating_modes.fitQuantization();
+#endif
+  
+  Serial.println("\n========== LEARNING PHASE COMPLETED ==========");
+  Serial.printf("Samples collected: %u\n", sensor_samples_collected);
+  Serial.printf("Baseline Mean: %.2f\n", anomaly_model.baseline_mean);
+  Serial.printf("Baseline Std Dev: %.2f\n", anomaly_model.baseline_std);
+  Serial.printf("Baseline RMS: %.2f\n", anomaly_model.baseline_rms);
+  Serial.printf("Adaptive Threshold: %.3f\n", anomaly_model.adaptive_threshold);
+  Serial.printf("Noise Floor: %.2f mV | SNR: %.1f dB\n",
+                noise_monitor.noiseRms() * 1000, noise_monitor.snrDb());
+  Serial.printf("Training Set: %d of %u feature vectors\n",
+                training_reservoir.size(), training_reservoir.offeredCount());
+#if ENABLE_QUANTIZED_SCORING
+  Serial.printf("Quantized Scoring: int%d | Score error bound: %.4f\n",
+                FEATURE_QUANT_BITS, quantized_score_error);
+#endif
+  Serial.printf("Operating Modes: %d\n", operating_modes.count());
+  for (int i = 0; i < operating_modes.count(); i++) {
+    const OperatingMode_t& mode = operating_modes.mode(i);
+    Serial.printf("  Mode %d: Mean %.2f | Std Dev %.2f | RMS %.2f | Windows %u\n",
+                  i, mode.baseline_mean, mode.baseline_std, mode.baseline_rms,
+                  mode.member_count);
+  }
+  Serial.println("System ready for anomaly detection\n");
+  
+  metrics.last_reset = millis();
+  feature_histograms.reset();
+  noise_monitor.latchBaseline();
+  envelope_demod.latchBaseline();
+  ar_residual.latchBaseline();
+}
+
+// ============================================================================
+// ADAPTIVE THRESHOLD ADJUSTMENT
+// ============================================================================
+
+void updateAdaptiveThreshold() {
+  /*
    * Bayesian update of threshold based on prediction history
    * - If mostly normal: slightly raise threshold (reduce false positives)
    * - If many anomalies: slightly lower threshold (improve sensitivity)
@@ -422,32 +2679,78 @@ struct AnomalyDecision {
   const char* primary_reason;
   const char* secondary_reason;
   float confidence;
+  const char* sensor_reason;  // Sensor health, independent of the process decision
 };
 
-AnomalyDecision classifyCurrentState() {
-  AnomalyDecision decision = {false, 0.0, "", "", 0.0};
+void recordDecision(AnomalyDecision& decision) {
+  // Sensor health is stamped on every decision, gated or not
+  noise_monitor.holdForProcess(decision.is_anomaly, last_feature_update);
+  decision.sensor_reason = noise_monitor.isDegraded() ? "NOISE_FLOOR_RISE" : "";
+  if (decision.sensor_reason[0] != '\0') metrics.sensor_degraded++;
+  
+  // Update metrics
+  metrics.total_predictions++;
+  if (decision.is_anomaly) {
+    anomaly_model.anomaly_count++;
+    metrics.anomalies_detected++;
+  } else {
+    anomaly_model.normal_count++;
+  }
+  
+  metrics.detection_rate = (float)metrics.anomalies_detected / 
+                           fmax(1, metrics.total_predictions);
+}
+
+AnomalyDecision scoreCurrentState() {
+  // Score and explain current_features; learns and counts nothing
+  AnomalyDecision decision = {false, 0.0, "", "", 0.0, ""};
   
   if (learning_phase_active) {
     decision.primary_reason = "LEARNING_PHASE";
     return decision;
   }
   
-  // Calculate anomaly score using isolation forest
-  decision.anomaly_score = isolation_forest.anomalyScore(current_features);
+  // Score against the nearest learned operating mode
+  active_mode = operating_modes.nearestMode(current_features);
+  const OperatingMode_t& mode = operating_modes.mode(active_mode);
+#if ENABLE_QUANTIZED_SCORING
+  QFeatures_t q_features;
+  feature_quantizer.apply(current_features, q_features);
+  decision.anomaly_score = operating_modes.forest(active_mode)
+                             .anomalyScoreQ(q_features) * (1.0f / Q16_ONE);
+#else
+  decision.anomaly_score = operating_modes.forest(active_mode)
+                             .anomalyScore(current_features, mode.baseline_std);
+#endif
   
-  // Determine if anomalous
-  decision.is_anomaly = (decision.anomaly_score > anomaly_model.adaptive_threshold);
+  // Determine if anomalous; envelope modulation, raw spikes and AR
+  // dynamics changes count on their own since the forest only sees the
+  // filtered window statistics
+  bool forest_anomaly = (decision.anomaly_score > anomaly_model.adaptive_threshold);
+  bool modulated = ENABLE_ENVELOPE && envelope_demod.isModulated();
+  bool spiking = RAW_SPIKE_VOTES && current_features.raw_spikes >= RAW_SPIKE_ALERT;
+  decision.is_anomaly = forest_anomaly || modulated || spiking ||
+                        (ENABLE_AR_RESIDUAL && AR_RESIDUAL_VOTES && ar_residual.isChanged());
   
   // Explain decision
   if (decision.is_anomaly) {
     decision.confidence = decision.anomaly_score;
     
-    if (fabs(current_features.mean - anomaly_model.baseline_mean) > 
-        anomaly_model.baseline_std * 2.0) {
+    if (!forest_anomaly && modulated) {
+      decision.primary_reason = "ENVELOPE_MODULATION";
+      decision.confidence = fmin(1.0, envelope_demod.ratio() / (2.0 * ENVELOPE_ALERT_RATIO));
+    } else if (!forest_anomaly && spiking) {
+      decision.primary_reason = "RAW_SPIKE";
+      decision.confidence = fmin(1.0, current_features.raw_spikes / (2.0 * RAW_SPIKE_ALERT));
+    } else if (!forest_anomaly) {
+      decision.primary_reason = "DYNAMICS_CHANGE";
+      decision.confidence = fmin(1.0, ar_residual.residualLevel() / (2.0 * AR_ALERT_RATIO));
+    } else if (fabs(current_features.mean - mode.baseline_mean) > 
+        mode.baseline_std * 2.0) {
       decision.primary_reason = "MEAN_SHIFT";
-    } else if (current_features.std_dev > anomaly_model.baseline_std * 1.8) {
+    } else if (current_features.std_dev > mode.baseline_std * 1.8) {
       decision.primary_reason = "HIGH_VARIANCE";
-    } else if (current_features.rms > anomaly_model.baseline_rms * 2.0) {
+    } else if (current_features.rms > mode.baseline_rms * 2.0) {
       decision.primary_reason = "SIGNAL_AMPLITUDE_INCREASE";
     } else if (fabs(current_features.trend) > 3.0) {
       decision.primary_reason = "RAPID_TREND";
@@ -456,7 +2759,7 @@ AnomalyDecision classifyCurrentState() {
     }
     
     if (current_features.max_val - current_features.min_val < 
-        anomaly_model.baseline_rms * 0.2) {
+        mode.baseline_std * 0.2) {
       decision.secondary_reason = "Abnormally stable signal";
     }
   } else {
@@ -464,19 +2767,398 @@ AnomalyDecision classifyCurrentState() {
     decision.primary_reason = "NORMAL";
   }
   
-  // Update metrics
-  metrics.total_predictions++;
-  if (decision.is_anomaly) {
-    anomaly_model.anomaly_count++;
-    metrics.anomalies_detected++;
-  } else {
-    anomaly_model.normal_count++;
+  return decision;
+}
+
+void learnFromDecision(const AnomalyDecision& decision) {
+  // Normal decisions, full or gated, drift the active mode and feed the
+  // training set, so quiet stretches count as much as eventful ones
+  if (decision.is_anomaly) return;
+  operating_modes.track(current_features, active_mode);
+  training_reservoir.offer(current_features);
+}
+
+AnomalyDecision classifyCurrentState() {
+  AnomalyDecision decision = scoreCurrentState();
+  if (learning_phase_active) return decision;
+  
+  learnFromDecision(decision);
+  recordDecision(decision);
+  
+  return decision;
+}
+
+// ============================================================================
+// CHANGE GATE: LAZY RE-EVALUATION
+// ============================================================================
+
+/*
+ * Skips scoring and explanation while the signal is quiet
+ *
+ * After each full evaluation the gate records the features, the decision
+ * and, per feature, the distance (slack) to every rule boundary the scorer
+ * and the explanation test: range bounds, trend and reason thresholds, and
+ * half the gap to the second-nearest operating mode. While every feature
+ * stays within its slack, the set of active rules cannot change, and each
+ * active deviation term moves by at most |delta| / range width. If the sum
+ * of those bounds (plus the quantization error) is below the current
+ * distance between the score and adaptive_threshold, the decision provably
+ * cannot flip and is reused. Features come from the O(1) accumulators,
+ * so a gated cycle never scans the window.
+ *
+ * Normal decisions keep drifting the active mode's baseline while the
+ * gate holds, which moves the stability limit (0.2 x baseline_std on the
+ * window range) and the nearest-mode boundary. Both are snapshotted at
+ * arm() and the drift since then is charged against their slack, so a
+ * slow drift cannot hold a stale decision; GATE_MAX_SKIPPED still forces
+ * a full evaluation every so many cycles regardless.
+ */
+
+class ChangeGate {
+private:
+  bool armed = false;
+  Features_t ref;
+  AnomalyDecision decision;
+  float slack[4];      // mean, std_dev, rms, trend
+  float weight[3];     // 1/width of active deviation terms (mean, std_dev, rms)
+  float mode_slack;
+  int mode_idx;
+  float armed_mean, armed_std;  // active mode baseline at arm()
+  float range_slack;   // window range to the stability limit at arm()
+  bool modulated;      // envelope flag the decision was taken with
+  bool dynamics;       // AR residual flag the decision was taken with
+  uint16_t skipped_in_row = 0;
+  
+public:
+  uint32_t evaluations = 0;
+  uint32_t skipped = 0;
+  
+  void disarm() { armed = false; }
+  
+  void arm(const Features_t& features, const AnomalyDecision& d, int active) {
+    LightweightIsolationForest& forest = operating_modes.forest(active);
+    const OperatingMode_t& mode = operating_modes.mode(active);
+    
+    ref = features;
+    mode_idx = active;
+    armed_mean = mode.baseline_mean;
+    armed_std = mode.baseline_std;
+    range_slack = fabs((features.max_val - features.min_val) - mode.baseline_std * 0.2f);
+    decision = d;
+    modulated = envelope_demod.isModulated();
+    dynamics = ar_residual.isChanged();
+    skipped_in_row = 0;
+    evaluations++;
+    
+    // Scorer boundaries
+    float lo = forest.rangeLower(0), hi = forest.rangeUpper(0);
+    slack[0] = fmin(fabs(features.mean - lo), fabs(features.mean - hi));
+    slack[1] = fabs(features.std_dev - forest.rangeUpper(1));
+    slack[2] = fabs(features.rms - forest.rangeUpper(2));
+    slack[3] = fabs(fabs(features.trend) - 5.0);
+    
+    weight[0] = (features.mean < lo || features.mean > hi) ? 1.0 / fmax(hi - lo, 0.001) : 0;
+    weight[1] = (features.std_dev > forest.rangeUpper(1)) ?
+                1.0 / fmax(forest.rangeUpper(1) - forest.rangeLower(1), 0.001) : 0;
+    weight[2] = (features.rms > forest.rangeUpper(2)) ?
+                1.0 / fmax(forest.rangeUpper(2) - forest.rangeLower(2), 0.001) : 0;
+    
+    // Explanation boundaries (only evaluated for anomalies)
+    if (d.is_anomaly) {
+      slack[0] = fmin(slack[0], fabs(fabs(features.mean - mode.baseline_mean) - mode.baseline_std * 2.0));
+      slack[1] = fmin(slack[1], fabs(features.std_dev - mode.baseline_std * 1.8));
+      slack[2] = fmin(slack[2], fabs(features.rms - mode.baseline_rms * 2.0));
+      slack[3] = fmin(slack[3], fabs(fabs(features.trend) - 3.0));
+    }
+    
+    // Nearest-mode boundary: half the gap to the runner-up
+    float d1 = FLT_MAX, d2 = FLT_MAX;
+    for (int i = 0; i < operating_modes.count(); i++) {
+      float dm = features.mean - operating_modes.mode(i).baseline_mean;
+      float ds = features.std_dev - operating_modes.mode(i).baseline_std;
+      float dist = sqrt(dm * dm + ds * ds);
+      if (dist < d1) { d2 = d1; d1 = dist; }
+      else if (dist < d2) { d2 = dist; }
+    }
+    mode_slack = (d2 == FLT_MAX) ? FLT_MAX : (d2 - d1) * 0.5f;
+    
+    armed = true;
+  }
+  
+  bool reuse(Features_t& features, AnomalyDecision& out) {
+    if (!armed || skipped_in_row >= GATE_MAX_SKIPPED) return false;
+    if (ENABLE_ENVELOPE && envelope_demod.isModulated() != modulated) return false;
+    if (ENABLE_AR_RESIDUAL && AR_RESIDUAL_VOTES && ar_residual.isChanged() != dynamics) return false;
+    
+    Features_t now;
+    if (!accumulatorFeatures(now)) return false;
+    if (RAW_SPIKE_VOTES &&
+        (now.raw_spikes >= RAW_SPIKE_ALERT) != (ref.raw_spikes >= RAW_SPIKE_ALERT)) {
+      return false;
+    }
+    
+    float delta[4] = {
+      fabs(now.mean - ref.mean),
+      fabs(now.std_dev - ref.std_dev),
+      fabs(now.rms - ref.rms),
+      fabs(now.trend - ref.trend)
+    };
+    for (int i = 0; i < 4; i++) {
+      if (delta[i] >= slack[i]) return false;
+    }
+    // Baseline drift since arm() moves the mode and stability boundaries
+    const OperatingMode_t& mode = operating_modes.mode(mode_idx);
+    float drift_mean = fabs(mode.baseline_mean - armed_mean);
+    float drift_std = fabs(mode.baseline_std - armed_std);
+    if (sqrt(delta[0] * delta[0] + delta[1] * delta[1]) + drift_mean + drift_std >= mode_slack) {
+      return false;
+    }
+    float delta_range = fabs((now.max_val - now.min_val) - (ref.max_val - ref.min_val));
+    if (delta_range + drift_std * 0.2f >= range_slack) return false;
+    
+    float bound = weight[0] * delta[0] + weight[1] * delta[1] + weight[2] * delta[2] +
+                  quantized_score_error;
+    if (bound >= fabs(decision.anomaly_score - anomaly_model.adaptive_threshold)) return false;
+    
+    features = now;
+    out = decision;
+    skipped_in_row++;
+    skipped++;
+    return true;
+  }
+};
+
+ChangeGate change_gate;
+
+// ============================================================================
+// ADAPTIVE SAMPLING RATE
+// ============================================================================
+
+/*
+ * Anomaly-likelihood driven acquisition rate
+ *
+ * While scores sit below RATE_CALM_FRACTION of adaptive_threshold for
+ * RATE_CALM_DECISIONS decisions in a row, the sample period doubles up to
+ * SAMPLE_PERIOD_MAX_MS. A score approaching the threshold, an anomaly, or
+ * a variance jump against the mode baseline drops straight back to the
+ * nominal SAMPLE_PERIOD_MS. Samples carry their own timestamps and trend
+ * is rescaled by the window's sample spacing, so features stay comparable.
+ * active_samples counts ADC conversions as a power proxy.
+ *
+ * Each cycle sleeps only for what is left of the period after processing,
+ * so processing time does not stretch the sample spacing. Samples are
+ * still missed when a cycle overruns by half a period. Interpolated slots
+ * smooth the window and can make a score look calmer than the signal
+ * is, so decisions taken while the window holds missed samples never
+ * count towards slowing down.
+ *
+ * Dropping back to the nominal rate restarts the adaptive feature window,
+ * so alerts are scored on nominal-rate samples rather than on a window
+ * that mixes both spacings.
+ */
+
+class SampleRateController {
+private:
+  uint16_t period_ms = SAMPLE_PERIOD_MS;
+  uint16_t calm_streak = 0;
+  
+public:
+  bool adaptive = ENABLE_ADAPTIVE_SAMPLING;
+  uint32_t active_samples = 0;
+  
+  uint16_t period() const { return period_ms; }
+  
+  void sleep(uint32_t cycle_start_ms) {
+    uint32_t busy_ms = millis() - cycle_start_ms;
+    delay(busy_ms < period_ms ? period_ms - busy_ms : 0);
+  }
+  
+  void reset() {
+#if ENABLE_ADAPTIVE_WINDOW
+    if (period_ms != SAMPLE_PERIOD_MS) adaptive_window.restart();
+#endif
+    period_ms = SAMPLE_PERIOD_MS;
+    calm_streak = 0;
+  }
+  
+  void update(const AnomalyDecision& decision, const Features_t& features) {
+    if (!adaptive) return;
+    
+    float threshold = anomaly_model.adaptive_threshold;
+    const OperatingMode_t& mode = operating_modes.mode(active_mode);
+    bool variance_jump = features.std_dev > mode.baseline_std * RATE_VARIANCE_JUMP;
+    
+    if (decision.is_anomaly || variance_jump ||
+        decision.anomaly_score >= threshold * RATE_ALERT_FRACTION) {
+      reset();
+      return;
+    }
+    
+    if (window_acc.missed > 0) {
+      // Partly interpolated window: its calm is not evidence
+    } else if (decision.anomaly_score < threshold * RATE_CALM_FRACTION) {
+      if (++calm_streak >= RATE_CALM_DECISIONS) {
+        calm_streak = 0;
+        if (period_ms * 2 <= SAMPLE_PERIOD_MAX_MS) period_ms *= 2;
+      }
+    } else {
+      calm_streak = 0;
+    }
+  }
+};
+
+SampleRateController sample_rate;
+
+// ============================================================================
+// SHADOW MODE: CANDIDATE DETECTORS
+// ============================================================================
+
+/*
+ * Alternate configurations scored on the live current_features
+ *
+ * Each shadow copies the learned per-mode forests, applies its own range
+ * scale, threshold offset and scorer, and scores the same features against
+ * the mode picked by the live detector. Its decisions are only tallied:
+ * agreement, shadow-only and live-only anomalies, and the onset lead of
+ * the shadow over the live detector for episodes both of them flag within
+ * SHADOW_MATCH_WINDOW_MS. Nothing a shadow decides is ever acted on.
+ * The time spent per shadow evaluation is measured with micros().
+ */
+
+typedef struct {
+  const char* name;
+  float threshold_offset;  // added to the live adaptive_threshold
+  float range_scale;       // scales the learned feature ranges about their centres
+  bool float_scorer;       // anomalyScore() even when quantized scoring is live
+} ShadowConfig_t;
+
+static const ShadowConfig_t shadow_configs[NUM_SHADOW_DETECTORS] = {
+  {"threshold +0.10", 0.10, 1.0, false},
+  {"ranges x1.5",     0.0,  1.5, false},
+};
+
+class ShadowDetectors {
+private:
+  struct Tally {
+    uint32_t agree;
+    uint32_t shadow_only;      // shadow flags, live does not
+    uint32_t live_only;        // live flags, shadow does not
+    bool live_prev, shadow_prev;
+    uint32_t live_onset_ms, shadow_onset_ms;  // 0 = no unmatched onset
+    int32_t lead_ms_sum;       // positive: shadow fired first
+    uint32_t matched_onsets;
+    uint32_t cost_us;
+    uint32_t evaluations;
+  };
+  
+  LightweightIsolationForest forests[NUM_SHADOW_DETECTORS][NUM_OPERATING_MODES];
+  Tally tally[NUM_SHADOW_DETECTORS];
+  bool ready = false;
+  
+  void build() {
+    for (int s = 0; s < NUM_SHADOW_DETECTORS; s++) {
+      for (int m = 0; m < operating_modes.count(); m++) {
+        forests[s][m] = operating_modes.forest(m);
+        forests[s][m].scaleFeatureRanges(shadow_configs[s].range_scale);
+#if ENABLE_QUANTIZED_SCORING
+        forests[s][m].buildQuantized(feature_quantizer, operating_modes.mode(m).baseline_std);
+#endif
+      }
+      memset(&tally[s], 0, sizeof(Tally));
+    }
+    ready = true;
+  }
+  
+  void matchOnsets(Tally& t) {
+    // Pair live and shadow onsets of the same episode, drop stale ones
+    uint32_t now = last_feature_update;
+    if (t.live_onset_ms && t.shadow_onset_ms) {
+      t.lead_ms_sum += (int32_t)(t.live_onset_ms - t.shadow_onset_ms);
+      t.matched_onsets++;
+      t.live_onset_ms = 0;
+      t.shadow_onset_ms = 0;
+    }
+    if (t.live_onset_ms && now - t.live_onset_ms > SHADOW_MATCH_WINDOW_MS) t.live_onset_ms = 0;
+    if (t.shadow_onset_ms && now - t.shadow_onset_ms > SHADOW_MATCH_WINDOW_MS) t.shadow_onset_ms = 0;
+  }
+  
+public:
+  void invalidate() { ready = false; }
+  
+  void evaluate(const Features_t& features, const AnomalyDecision& live) {
+    if (!ready) build();
+    
+#if ENABLE_QUANTIZED_SCORING
+    QFeatures_t q_features;
+    feature_quantizer.apply(features, q_features);
+#endif
+    const OperatingMode_t& mode = operating_modes.mode(active_mode);
+    
+    for (int s = 0; s < NUM_SHADOW_DETECTORS; s++) {
+      const ShadowConfig_t& config = shadow_configs[s];
+      Tally& t = tally[s];
+      uint32_t start_us = micros();
+      
+      float score;
+#if ENABLE_QUANTIZED_SCORING
+      if (!config.float_scorer) {
+        score = forests[s][active_mode].anomalyScoreQ(q_features) * (1.0f / Q16_ONE);
+      } else
+#endif
+      {
+        score = forests[s][active_mode].anomalyScore(features, mode.baseline_std);
+      }
+      bool is_anomaly = score > anomaly_model.adaptive_threshold + config.threshold_offset;
+      
+      t.cost_us += micros() - start_us;
+      t.evaluations++;
+      
+      if (is_anomaly == live.is_anomaly) t.agree++;
+      else if (is_anomaly) t.shadow_only++;
+      else t.live_only++;
+      
+      if (live.is_anomaly && !t.live_prev) t.live_onset_ms = last_feature_update;
+      if (is_anomaly && !t.shadow_prev) t.shadow_onset_ms = last_feature_update;
+      t.live_prev = live.is_anomaly;
+      t.shadow_prev = is_anomaly;
+      matchOnsets(t);
+    }
   }
   
-  metrics.detection_rate = (float)metrics.anomalies_detected / 
-                           fmax(1, metrics.total_predictions);
+  void refreshBaseline(int mode, float baseline_std) {
+    // Follow the primary's tracked baseline (their range scale stays)
+    if (!ready) return;
+#if ENABLE_QUANTIZED_SCORING
+    for (int s = 0; s < NUM_SHADOW_DETECTORS; s++) {
+      forests[s][mode].refreshQuantizedBaseline(feature_quantizer, baseline_std);
+    }
+#else
+    (void)mode;
+    (void)baseline_std;
+#endif
+  }
   
-  return decision;
+  void printSummary() {
+    if (!ready) return;
+    
+    Serial.println("\nShadow Detectors:");
+    for (int s = 0; s < NUM_SHADOW_DETECTORS; s++) {
+      const Tally& t = tally[s];
+      Serial.printf("  %s: agree %u | shadow-only %u | live-only %u",
+                    shadow_configs[s].name, t.agree, t.shadow_only, t.live_only);
+      if (t.matched_onsets > 0) {
+        Serial.printf(" | lead %.0f ms over %u onsets",
+                      (float)t.lead_ms_sum / t.matched_onsets, t.matched_onsets);
+      }
+      Serial.printf(" | %.1f us/eval\n", (float)t.cost_us / fmax(1, t.evaluations));
+    }
+  }
+};
+
+ShadowDetectors shadow_detectors;
+
+void refreshShadowBaseline(int mode, float baseline_std) {
+  shadow_detectors.refreshBaseline(mode, baseline_std);
 }
 
 // ============================================================================
@@ -484,14 +3166,15 @@ AnomalyDecision classifyCurrentState() {
 // ============================================================================
 
 void printDecision(const AnomalyDecision& decision) {
+  if (tunables.verbosity < 1) return;
   if (metrics.total_predictions % 10 != 0) return;  // Reduce serial output frequency
   
-  Serial.printf("[%u ms] ", millis());
+  Serial.printf("[%u ms] ", last_feature_update);  // Cycle time, also for block input
   
   if (learning_phase_active) {
-    Serial.printf("LEARNING: %u/60s | Samples: %u | ", 
-                  (millis() - learning_start_time) / 1000,
-                  sensor_samples_collected);
+    Serial.printf("LEARNING: %u/%us | Samples: %u | ", 
+                  (last_feature_update - learning_start_time) / 1000,
+                  learningDurationMs() / 1000, sensor_samples_collected);
   } else {
     Serial.printf("Status: %s | ", decision.is_anomaly ? "ANOMALY" : "NORMAL");
     Serial.printf("Score: %.3f | Threshold: %.3f | ", 
@@ -502,22 +3185,40 @@ void printDecision(const AnomalyDecision& decision) {
     if (decision.secondary_reason[0] != '\0') {
       Serial.printf(" | %s", decision.secondary_reason);
     }
+    if (decision.sensor_reason[0] != '\0') {
+      Serial.printf(" | Sensor: %s (SNR %.1f dB)", decision.sensor_reason, noise_monitor.snrDb());
+    }
   }
   
   Serial.println();
 }
 
+void dumpDiagnostics();
+
 void printDetailedDiagnostics() {
+  if (tunables.verbosity < 2) return;
   if (metrics.total_predictions % 100 != 0) return;
   
+  dumpDiagnostics();
+}
+
+void dumpDiagnostics() {
+  const OperatingMode_t& mode = operating_modes.mode(active_mode);
+  
   Serial.println("\n========== DETAILED DIAGNOSTICS ==========");
+  Serial.printf("Operating Mode: %d of %d\n", active_mode, operating_modes.count());
   Serial.printf("Current Mean: %.2f (Baseline: %.2f)\n", 
-                current_features.mean, anomaly_model.baseline_mean);
+                current_features.mean, mode.baseline_mean);
   Serial.printf("Current Std Dev: %.2f (Baseline: %.2f)\n", 
-                current_features.std_dev, anomaly_model.baseline_std);
+                current_features.std_dev, mode.baseline_std);
   Serial.printf("Current RMS: %.2f (Baseline: %.2f)\n", 
-                current_features.rms, anomaly_model.baseline_rms);
+                current_features.rms, mode.baseline_rms);
   Serial.printf("Current Trend: %.3f\n", current_features.trend);
+#if ENABLE_ADAPTIVE_WINDOW
+  Serial.printf("Feature Window: %u of %u samples | %u cuts | %d buckets\n",
+                featureWindow(), tunables.feature_window, adaptive_window.cuts,
+                adaptive_window.bucketCount());
+#endif
   Serial.printf("Signal Range: %.2f to %.2f\n", 
                 current_features.min_val, current_features.max_val);
   Serial.printf("\nDetection Rate: %.1f%% (%u/%u predictions)\n", 
@@ -526,9 +3227,717 @@ void printDetailedDiagnostics() {
                 metrics.total_predictions);
   Serial.printf("Normal: %u | Anomalies: %u\n", 
                 anomaly_model.normal_count, anomaly_model.anomaly_count);
+  Serial.printf("Noise Floor: %.2f mV (Learned: %.2f) | SNR: %.1f dB | Sensor: %s\n",
+                noise_monitor.noiseRms() * 1000, noise_monitor.learnedNoiseRms() * 1000,
+                noise_monitor.snrDb(), noise_monitor.isDegraded() ? "DEGRADED" : "OK");
+  Serial.printf("Sensor Faults: %u onsets | %u cycles skipped | Now: %s\n",
+                sensor_fault.onsets, metrics.sensor_faults, sensor_fault.name());
+#if ENABLE_ENVELOPE
+  Serial.printf("Envelope Bands (mV):");
+  for (int b = 0; b < ENVELOPE_BANDS; b++) Serial.printf(" %.2f", current_features.envelope[b] * 1000);
+  Serial.printf(" | Ratio: %.1f | %s\n", envelope_demod.ratio(),
+                envelope_demod.isModulated() ? "MODULATED" : "OK");
+#endif
+  Serial.printf("Raw Path: %u spikes | max step %.1f mV | range %.1f mV\n",
+                current_features.raw_spikes, current_features.raw_step * 1000,
+                current_features.raw_range * 1000);
+#if ENABLE_AR_RESIDUAL
+  Serial.printf("AR(%d) Residual: %.2f x learned | Last z^2: %.2f | %s\n", AR_ORDER,
+                current_features.ar_residual, ar_residual.lastScore(),
+                ar_residual.isChanged() ? "DYNAMICS CHANGED" : "OK");
+#endif
+  Serial.printf("Sample Period: %u ms | ADC samples: %u\n",
+                sample_rate.period(), sample_rate.active_samples);
+  Serial.printf("Sample Gaps: %u | Missed: %u total, %u in window (%u open gaps)\n",
+                metrics.sample_gaps, metrics.samples_missed,
+                window_acc.missed, window_acc.gaps);
+#if ENABLE_CHANGE_GATE
+  Serial.printf("Change Gate: %u skipped | %u full evaluations\n",
+                change_gate.skipped, change_gate.evaluations);
+#endif
+  shadow_detectors.printSummary();
   Serial.println("=========================================\n");
 }
 
+// ============================================================================
+// DECISION JOURNAL: RESET-RETAINED MEMORY
+// ============================================================================
+
+/*
+ * What happened before a watchdog reset or brownout
+ *
+ * A small journal lives in RTC_NOINIT memory, which the ESP32 keeps across
+ * every reset short of losing power (a file via RETAINED_MEMORY on the
+ * host). It holds lifetime counters and a ring of JOURNAL_ENTRIES events:
+ * boots with their reset reason, anomaly episode starts and ends, sensor
+ * fault changes, the threshold after every (re)learning, and every
+ * JOURNAL_HEARTBEAT-th decision, each stamped with the time of the sample
+ * or cycle it records (processBlock() runs behind the clock). With it,
+ * running at verbosity 0 loses nothing that matters: the "journal"
+ * command prints it on demand and a recovered journal is summarized at
+ * boot.
+ *
+ * Every record validates itself, so a reset in the middle of a write costs
+ * at most that record:
+ * - Header: magic, layout version, boot count, CRC-32
+ * - Entries: sequence number and CRC; recovery takes the highest valid
+ *   sequence as the newest, so appends never touch the header (O(1))
+ * - Counters: two slots written alternately with sequence and CRC;
+ *   recovery keeps the newer valid one
+ * Session counters in metrics are added to the totals recovered at boot.
+ */
+
+typedef enum {
+  JOURNAL_BOOT,            // value: reset reason
+  JOURNAL_LEARNED,         // value: adaptive threshold x 1000
+  JOURNAL_ANOMALY_START,   // value: score x 1000
+  JOURNAL_ANOMALY_END,     // value: decisions in the episode
+  JOURNAL_SENSOR_FAULT,    // reason: SensorFault_t
+  JOURNAL_FAULT_CLEARED,
+  JOURNAL_HEARTBEAT_SCORE, // value: score x 1000
+} JournalEvent_t;
+
+typedef struct {
+  uint32_t seq;
+  uint32_t time_ms;
+  uint16_t boot;
+  uint8_t event;
+  uint8_t reason;          // index into journal_reasons (or SensorFault_t)
+  uint16_t value;
+  uint16_t crc;            // low half of the CRC-32 of the bytes above
+} JournalEntry_t;
+
+typedef struct {
+  uint32_t seq;
+  uint32_t predictions;
+  uint32_t anomalies;
+  uint32_t episodes;
+  uint32_t sensor_faults;
+  uint32_t samples_missed;
+  uint32_t resets;         // boots other than power-on
+  uint32_t crc;
+} JournalCounters_t;
+
+typedef struct {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t boot_count;
+  uint32_t crc;
+  JournalCounters_t counters[2];
+  JournalEntry_t entries[JOURNAL_ENTRIES];
+} RetainedJournal_t;
+
+#define JOURNAL_MAGIC 0x4A524E4Cu      // "JRNL"
+#define JOURNAL_VERSION 1
+
+#ifdef RETAINED_MEMORY
+static RetainedJournal_t* const journal_store =
+  (RetainedJournal_t*)RETAINED_MEMORY(sizeof(RetainedJournal_t));
+#else
+RTC_NOINIT_ATTR static RetainedJournal_t journal_rtc;
+static RetainedJournal_t* const journal_store = &journal_rtc;
+#endif
+
+static const char* const journal_reasons[] = {
+  "", "NORMAL", "MEAN_SHIFT", "HIGH_VARIANCE", "SIGNAL_AMPLITUDE_INCREASE",
+  "RAPID_TREND", "COMBINED_DEVIATION", "ENVELOPE_MODULATION", "LEARNING_PHASE",
+  "DYNAMICS_CHANGE", "RAW_SPIKE",
+};
+static const int NUM_JOURNAL_REASONS = sizeof(journal_reasons) / sizeof(journal_reasons[0]);
+
+class DecisionJournal {
+private:
+  RetainedJournal_t* store;
+  JournalCounters_t base;    // totals recovered at boot
+  JournalCounters_t live;
+  uint32_t next_seq = 0;
+  uint16_t head = 0;         // slot of the next entry
+  uint32_t episode_length = 0;
+  uint32_t decisions = 0;
+  bool in_episode = false;
+  bool learned = false;
+  
+  static uint32_t headerCrc(const RetainedJournal_t* j) {
+    return crc32(j, offsetof(RetainedJournal_t, crc));
+  }
+  static uint16_t entryCrc(const JournalEntry_t& e) {
+    return (uint16_t)crc32(&e, offsetof(JournalEntry_t, crc));
+  }
+  static uint32_t countersCrc(const JournalCounters_t& c) {
+    return crc32(&c, offsetof(JournalCounters_t, crc));
+  }
+  
+  static uint8_t reasonCode(const char* reason) {
+    for (int i = 1; i < NUM_JOURNAL_REASONS; i++) {
+      if (reason == journal_reasons[i] || strcmp(reason, journal_reasons[i]) == 0) return i;
+    }
+    return 0;
+  }
+  
+  static uint16_t scaled(float value) {
+    return (uint16_t)fmax(0.0, fmin(65535.0, value * 1000.0f));
+  }
+  
+  void append(JournalEvent_t event, uint8_t reason, uint16_t value, uint32_t time_ms) {
+    JournalEntry_t e;
+    memset(&e, 0, sizeof(e));
+    e.seq = next_seq++;
+    e.time_ms = time_ms;
+    e.boot = store->boot_count;
+    e.event = event;
+    e.reason = reason;
+    e.value = value;
+    e.crc = entryCrc(e);
+    store->entries[head] = e;
+    head = (head + 1) % JOURNAL_ENTRIES;
+  }
+  
+  void writeCounters() {
+    live.predictions = base.predictions + metrics.total_predictions;
+    live.anomalies = base.anomalies + metrics.anomalies_detected;
+    live.sensor_faults = base.sensor_faults + metrics.sensor_faults;
+    live.samples_missed = base.samples_missed + metrics.samples_missed;
+    live.seq++;
+    live.crc = countersCrc(live);
+    store->counters[live.seq & 1] = live;
+  }
+  
+  bool entryValid(int i) const {
+    const JournalEntry_t& e = store->entries[i];
+    return e.crc == entryCrc(e) && e.event <= JOURNAL_HEARTBEAT_SCORE;
+  }
+  
+  void printEntry(const JournalEntry_t& e) const {
+    static const char* const names[] = {
+      "BOOT", "LEARNED", "ANOMALY_START", "ANOMALY_END", "SENSOR_FAULT",
+      "FAULT_CLEARED", "SCORE",
+    };
+    Serial.printf("  #%u boot %u [%u ms] %s", e.seq, e.boot, e.time_ms, names[e.event]);
+    switch (e.event) {
+      case JOURNAL_BOOT:
+        Serial.printf(" reset=%s\n", resetReasonName(e.value));
+        break;
+      case JOURNAL_LEARNED:
+        Serial.printf(" threshold=%.3f\n", e.value / 1000.0f);
+        break;
+      case JOURNAL_ANOMALY_END:
+        Serial.printf(" decisions=%u\n", e.value);
+        break;
+      case JOURNAL_SENSOR_FAULT:
+        Serial.printf(" fault=%s\n", SensorFaultDetector::name((SensorFault_t)e.reason));
+        break;
+      case JOURNAL_FAULT_CLEARED:
+        Serial.println();
+        break;
+      default:
+        Serial.printf(" score=%.3f reason=%s\n", e.value / 1000.0f,
+                      e.reason < NUM_JOURNAL_REASONS ? journal_reasons[e.reason] : "?");
+    }
+  }
+  
+public:
+  bool recovered = false;
+  
+  DecisionJournal(RetainedJournal_t* region) : store(region) {}
+  
+  static const char* resetReasonName(int reason) {
+    switch (reason) {
+      case ESP_RST_POWERON:  return "POWER_ON";
+      case ESP_RST_EXT:      return "EXTERNAL";
+      case ESP_RST_SW:       return "SOFTWARE";
+      case ESP_RST_PANIC:    return "PANIC";
+      case ESP_RST_INT_WDT:  return "INT_WATCHDOG";
+      case ESP_RST_TASK_WDT: return "TASK_WATCHDOG";
+      case ESP_RST_WDT:      return "WATCHDOG";
+      case ESP_RST_DEEPSLEEP: return "DEEP_SLEEP";
+      case ESP_RST_BROWNOUT: return "BROWNOUT";
+      default:               return "UNKNOWN";
+    }
+  }
+  
+  void begin() {
+    // Validate and recover, or format: runs once per boot, O(entries)
+    recovered = store->magic == JOURNAL_MAGIC && store->version == JOURNAL_VERSION &&
+                store->crc == headerCrc(store);
+    memset(&base, 0, sizeof(base));
+    next_seq = 0;
+    head = 0;
+    
+    if (recovered) {
+      for (int i = 0; i < JOURNAL_ENTRIES; i++) {
+        if (entryValid(i) && store->entries[i].seq >= next_seq) {
+          next_seq = store->entries[i].seq + 1;
+          head = (i + 1) % JOURNAL_ENTRIES;
+        }
+      }
+      for (int s = 0; s < 2; s++) {
+        const JournalCounters_t& c = store->counters[s];
+        if (c.crc == countersCrc(c) && c.seq >= base.seq) base = c;
+      }
+    } else {
+      memset(store, 0, sizeof(RetainedJournal_t));
+      store->magic = JOURNAL_MAGIC;
+      store->version = JOURNAL_VERSION;
+    }
+    
+    esp_reset_reason_t reason = esp_reset_reason();
+    if (recovered && reason != ESP_RST_POWERON) base.resets++;
+    store->boot_count++;
+    store->crc = headerCrc(store);
+    live = base;
+    append(JOURNAL_BOOT, 0, (uint16_t)reason, millis());
+    writeCounters();
+  }
+  
+  // Learning restarted: the first decision after it records the new threshold
+  void noteRelearn() { learned = false; }
+  
+  void recordDecision(const AnomalyDecision& decision, uint32_t time_ms) {
+    // time_ms: the decision's cycle time, not when a block was processed
+    if (!learned) {
+      learned = true;
+      append(JOURNAL_LEARNED, 0, scaled(anomaly_model.adaptive_threshold), time_ms);
+    }
+    
+    if (decision.is_anomaly && !in_episode) {
+      in_episode = true;
+      episode_length = 0;
+      live.episodes++;
+      append(JOURNAL_ANOMALY_START, reasonCode(decision.primary_reason),
+             scaled(decision.anomaly_score), time_ms);
+    } else if (!decision.is_anomaly && in_episode) {
+      in_episode = false;
+      append(JOURNAL_ANOMALY_END, 0, episode_length > 65535 ? 65535 : episode_length, time_ms);
+    }
+    if (in_episode) episode_length++;
+    
+    if (++decisions % JOURNAL_HEARTBEAT == 0) {
+      append(JOURNAL_HEARTBEAT_SCORE, reasonCode(decision.primary_reason),
+             scaled(decision.anomaly_score), time_ms);
+    }
+    writeCounters();
+  }
+  
+  void recordSensorFault(SensorFault_t fault, uint32_t time_ms) {
+    if (fault == FAULT_NONE) append(JOURNAL_FAULT_CLEARED, 0, 0, time_ms);
+    else append(JOURNAL_SENSOR_FAULT, (uint8_t)fault, 0, time_ms);
+    writeCounters();
+  }
+  
+  void print(int newest) const {
+    // The newest entries, oldest first
+    Serial.printf("Journal: boot %u | lifetime: %u predictions, %u anomalies, %u episodes, "
+                  "%u sensor-fault cycles, %u samples missed, %u resets\n",
+                  store->boot_count, live.predictions, live.anomalies, live.episodes,
+                  live.sensor_faults, live.samples_missed, live.resets);
+    for (int k = JOURNAL_ENTRIES; k >= 1; k--) {
+      int i = (head - k + JOURNAL_ENTRIES) % JOURNAL_ENTRIES;
+      if (entryValid(i) && store->entries[i].seq + newest >= next_seq) printEntry(store->entries[i]);
+    }
+  }
+};
+
+DecisionJournal journal(journal_store);
+
+void noteJournalRelearn() {
+#if ENABLE_JOURNAL
+  journal.noteRelearn();
+#endif
+}
+
+// ============================================================================
+// SELF-TEST: SYNTHETIC FAULT INJECTION
+// ============================================================================
+
+/*
+ * Does the deployed detector still catch a known fault in time?
+ *
+ * "selftest <step|spike|burst>" adds a fault signature to the raw voltage
+ * between the ADC and SensorFilter::apply() for up to SELF_TEST_MAX_MS, so
+ * the filter, window, features and scorer see it as they would a real
+ * fault (the ADC-code sensor checks and the envelope demodulator do not):
+ * - step:  constant offset of SELF_TEST_STEP_V
+ * - spike: SELF_TEST_SPIKE_V on every SELF_TEST_SPIKE_EVERY-th sample
+ * - burst: uniform noise of +/-SELF_TEST_BURST_V
+ * Each feature cycle is scored in full (no change gate), and the sample
+ * rate reacts as it would to a real fault. Nothing is learned or counted:
+ * no mode tracking, training set, metrics, threshold adaptation,
+ * histograms, shadow tallies or journal entries, and the noise floor is
+ * held. The test ends at the first ANOMALY decision (PASS within
+ * SELF_TEST_BUDGET_MS) or at the time limit, and the window is flushed so
+ * injected samples never reach a live decision. Relearning or a sensor
+ * fault aborts it.
+ */
+
+typedef enum {
+  SELF_TEST_STEP,
+  SELF_TEST_SPIKE,
+  SELF_TEST_BURST,
+  NUM_SELF_TESTS
+} SelfTestKind_t;
+
+class SelfTest {
+private:
+  bool running = false;
+  SelfTestKind_t kind = SELF_TEST_STEP;
+  uint32_t start_ms = 0;
+  uint32_t samples = 0;
+  uint32_t noise_state = 1;
+  float peak_score = 0;
+  
+  // Last result
+  bool has_result = false;
+  SelfTestKind_t result_kind = SELF_TEST_STEP;
+  const char* verdict = "";
+  const char* reason = "";
+  uint32_t latency_ms = 0;
+  float result_score = 0;
+  
+  void finish(const char* outcome, const char* why, uint32_t now) {
+    running = false;
+    has_result = true;
+    result_kind = kind;
+    verdict = outcome;
+    reason = why;
+    latency_ms = now - start_ms;
+    result_score = peak_score;
+    runs++;
+    if (strcmp(outcome, "PASS") == 0) passes++;
+    print();
+  }
+  
+public:
+  uint16_t runs = 0;
+  uint16_t passes = 0;
+  
+  static const char* name(SelfTestKind_t k) {
+    switch (k) {
+      case SELF_TEST_STEP:  return "step";
+      case SELF_TEST_SPIKE: return "spike";
+      case SELF_TEST_BURST: return "burst";
+      default:              return "?";
+    }
+  }
+  
+  static bool parse(const char* text, SelfTestKind_t& k) {
+    for (int i = 0; i < NUM_SELF_TESTS; i++) {
+      if (strcmp(text, name((SelfTestKind_t)i)) == 0) {
+        k = (SelfTestKind_t)i;
+        return true;
+      }
+    }
+    return false;
+  }
+  
+  bool active() const { return running; }
+  
+  void start(SelfTestKind_t k) {
+    running = true;
+    kind = k;
+    start_ms = millis();
+    samples = 0;
+    peak_score = 0;
+  }
+  
+  float tap(float raw_value) {
+    // Between the ADC and the filter
+    if (!running) return raw_value;
+    samples++;
+    switch (kind) {
+      case SELF_TEST_STEP:
+        return raw_value + SELF_TEST_STEP_V;
+      case SELF_TEST_SPIKE:
+        return raw_value + ((samples % SELF_TEST_SPIKE_EVERY == 0) ? SELF_TEST_SPIKE_V : 0);
+      default:
+        noise_state = noise_state * 1664525u + 1013904223u;
+        return raw_value + SELF_TEST_BURST_V * (((noise_state >> 8) * (1.0f / 8388608.0f)) - 1.0f);
+    }
+  }
+  
+  bool observe(const AnomalyDecision& decision, uint32_t now) {
+    // True once the test has ended
+    peak_score = fmax(peak_score, decision.anomaly_score);
+    if (decision.is_anomaly) {
+      finish((now - start_ms <= SELF_TEST_BUDGET_MS) ? "PASS" : "FAIL",
+             decision.primary_reason, now);
+    } else if (now - start_ms >= SELF_TEST_MAX_MS) {
+      finish("FAIL", "NOT_DETECTED", now);
+    }
+    return !running;
+  }
+  
+  void abort(const char* why) {
+    if (running) finish("ABORTED", why, millis());
+  }
+  
+  void print() const {
+    if (!has_result) {
+      Serial.println("Self-test: none run");
+      return;
+    }
+    Serial.printf("[%u ms] SELF-TEST %s: %s after %u ms (budget %u) | Reason: %s | "
+                  "Peak score: %.3f | %u/%u passed\n", millis(), name(result_kind), verdict,
+                  latency_ms, SELF_TEST_BUDGET_MS, reason, result_score, passes, runs);
+  }
+};
+
+SelfTest self_test;
+
+void abortSelfTest(const char* why) {
+  self_test.abort(why);
+}
+
+// ============================================================================
+// RUNTIME COMMAND INTERFACE
+// ============================================================================
+
+/*
+ * Line-based serial commands, polled at the top of loop()
+ *
+ * At most CMD_POLL_BUDGET_US per loop() is spent reading input, so a
+ * chatty host cannot stall acquisition. Complete lines execute before the
+ * next cycle starts, which makes every change atomic with respect to the
+ * pipeline. Replies start with "OK" or "ERR" for easy scripting.
+ *
+ *   get [name]          list all tunables, or one
+ *   set <name> <value>  change a tunable
+ *   relearn             restart the learning phase
+ *   diag                dump detailed diagnostics now
+ *   snapshot            dump the current window (ms, raw V, filtered V)
+ *   counters            prediction, sample and gate counters
+ *   hist [reset]        dump (or clear) the score/feature histograms
+ *   mathbench           time exact vs fast math kernels on this board
+ *   journal             print the reset-retained decision journal
+ *   model               export the learned model for the host fleet tool
+ *   prior [begin|<hex>|end|clear]
+ *                       show the fleet prior, or load one: begin, hex
+ *                       chunks, then end checks it and relearns briefly
+ *                       on top of it; clear drops it
+ *   selftest [step|spike|burst]
+ *                       inject a synthetic fault and time its detection,
+ *                       or show the last result
+ *
+ * Changing feature_window invalidates the learned baselines, so it
+ * restarts learning, and flushes the window so the first one at the new
+ * length is not built from sums over the old one.
+ * host/command_check.cpp drives these through poll() and checks replies.
+ */
+
+typedef struct {
+  const char* name;
+  float* f;          // exactly one of f / u is set
+  uint16_t* u;
+  float min_val, max_val;
+  bool relearn;      // learned baselines depend on this value
+} Tunable_t;
+
+static const Tunable_t tunable_table[] = {
+  {"filter_alpha",       &tunables.filter_alpha,             NULL, 0.01, 1.0,   false},
+  {"anomaly_threshold",  &tunables.anomaly_threshold,        NULL, 0.05, 1.0,   false},
+  {"adaptive_threshold", &anomaly_model.adaptive_threshold,  NULL, 0.0,  1.0,   false},
+  {"feature_window",     NULL, &tunables.feature_window,           2,    BUFFER_SIZE, true},
+  {"update_interval_ms", NULL, &tunables.update_interval_ms,       10,   10000, false},
+  {"verbosity",          NULL, &tunables.verbosity,                0,    2,     false},
+};
+static const int NUM_TUNABLES = sizeof(tunable_table) / sizeof(tunable_table[0]);
+
+class CommandInterface {
+private:
+  char line[CMD_LINE_MAX];
+  uint8_t length = 0;
+  bool overflow = false;
+  
+  const Tunable_t* findTunable(const char* name) {
+    for (int i = 0; i < NUM_TUNABLES; i++) {
+      if (strcmp(tunable_table[i].name, name) == 0) return &tunable_table[i];
+    }
+    return NULL;
+  }
+  
+  void printTunable(const Tunable_t& t) {
+    if (t.f) Serial.printf("OK %s=%.4f\n", t.name, *t.f);
+    else Serial.printf("OK %s=%u\n", t.name, *t.u);
+  }
+  
+  void setTunable(const char* name, const char* text) {
+    const Tunable_t* t = findTunable(name);
+    if (t == NULL) {
+      Serial.printf("ERR unknown tunable '%s'\n", name);
+      return;
+    }
+    
+    // Integer tunables take integers only: no silent truncation or wrap
+    char* end;
+    float value = t->f ? strtof(text, &end) : (float)strtol(text, &end, 10);
+    if (end == text || *end != '\0' || value < t->min_val || value > t->max_val) {
+      Serial.printf("ERR %s must be %s in [%g, %g]\n", t->name, t->f ? "a number" : "an integer",
+                    t->min_val, t->max_val);
+      return;
+    }
+    
+    if (t->f) *t->f = value;
+    else *t->u = (uint16_t)value;
+    printTunable(*t);
+    
+    // The window accumulators hold the old length: refill, don't mix
+    if (t->u == &tunables.feature_window) flushSensorWindow();
+    if (t->relearn) enterLearningPhase();
+  }
+  
+  void printSnapshot() {
+    uint16_t window = tunables.feature_window;
+    Serial.printf("OK snapshot %u samples\n", window);
+    for (int i = 0; i < window; i++) {
+      int idx = (buffer_index - window + i + BUFFER_SIZE) % BUFFER_SIZE;
+      if (!sensor_buffer[idx].is_valid) continue;
+      Serial.printf("%u,%.4f,%.4f\n", sensor_buffer[idx].timestamp,
+                    sensor_buffer[idx].raw_value, sensor_buffer[idx].filtered_value);
+    }
+  }
+  
+  void priorCommand(const char* arg) {
+#if ENABLE_FLEET_PRIOR
+    if (arg == NULL) {
+      fleet_prior.print();
+    } else if (strcmp(arg, "begin") == 0) {
+      fleet_prior.begin();
+      Serial.println("OK prior begin");
+    } else if (strcmp(arg, "end") == 0) {
+      const char* error = fleet_prior.commit();
+      if (error) {
+        Serial.printf("ERR prior %s\n", error);
+        return;
+      }
+      fleet_prior.print();
+      enterLearningPhase();  // Short learning, merged with the prior
+    } else if (strcmp(arg, "clear") == 0) {
+      fleet_prior.clear();
+      Serial.println("OK prior clear");
+    } else if (fleet_prior.feed(arg)) {
+      Serial.printf("OK prior %u/%u bytes\n", fleet_prior.stagedBytes(), (unsigned)sizeof(FleetPrior_t));
+    } else {
+      Serial.println("ERR prior bad chunk (restart with 'prior begin')");
+    }
+#else
+    (void)arg;
+    Serial.println("ERR fleet prior disabled");
+#endif
+  }
+  
+  void selfTestCommand(const char* arg) {
+#if ENABLE_SELF_TEST
+    SelfTestKind_t kind;
+    if (arg == NULL) {
+      self_test.print();
+    } else if (!SelfTest::parse(arg, kind)) {
+      Serial.println("ERR selftest step|spike|burst");
+    } else if (learning_phase_active || sensor_fault.current() != FAULT_NONE ||
+               self_test.active()) {
+      Serial.println("ERR selftest needs a learned model, a healthy input and no test running");
+    } else {
+      self_test.start(kind);
+      Serial.printf("OK selftest %s\n", SelfTest::name(kind));
+    }
+#else
+    (void)arg;
+    Serial.println("ERR self-test disabled");
+#endif
+  }
+  
+  void printCounters() {
+    Serial.printf("OK predictions=%u anomalies=%u normal=%u samples=%u adc_samples=%u",
+                  metrics.total_predictions, metrics.anomalies_detected,
+                  anomaly_model.normal_count, sensor_samples_collected,
+                  sample_rate.active_samples);
+#if ENABLE_CHANGE_GATE
+    Serial.printf(" gate_skipped=%u", change_gate.skipped);
+#endif
+    Serial.printf(" sensor_faults=%u", metrics.sensor_faults);
+    Serial.printf(" sample_gaps=%u samples_missed=%u", metrics.sample_gaps, metrics.samples_missed);
+    Serial.printf(" sensor_degraded=%u noise_mv=%.3f snr_db=%.1f", metrics.sensor_degraded,
+                  noise_monitor.noiseRms() * 1000, noise_monitor.snrDb());
+    Serial.println();
+  }
+  
+  void execute(char* text) {
+    char* command = strtok(text, " \t");
+    char* arg1 = strtok(NULL, " \t");
+    char* arg2 = strtok(NULL, " \t");
+    if (command == NULL) return;
+    
+    if (strcmp(command, "get") == 0) {
+      if (arg1 == NULL) {
+        for (int i = 0; i < NUM_TUNABLES; i++) printTunable(tunable_table[i]);
+      } else if (const Tunable_t* t = findTunable(arg1)) {
+        printTunable(*t);
+      } else {
+        Serial.printf("ERR unknown tunable '%s'\n", arg1);
+      }
+    } else if (strcmp(command, "set") == 0 && arg1 && arg2) {
+      setTunable(arg1, arg2);
+    } else if (strcmp(command, "relearn") == 0) {
+      Serial.println("OK relearn");
+      enterLearningPhase();
+    } else if (strcmp(command, "diag") == 0) {
+      Serial.println("OK diag");
+      dumpDiagnostics();
+    } else if (strcmp(command, "snapshot") == 0) {
+      printSnapshot();
+    } else if (strcmp(command, "counters") == 0) {
+      printCounters();
+    } else if (strcmp(command, "hist") == 0) {
+      if (arg1 && strcmp(arg1, "reset") == 0) {
+        feature_histograms.reset();
+        Serial.println("OK hist reset");
+      } else {
+        feature_histograms.dump();
+      }
+    } else if (strcmp(command, "mathbench") == 0) {
+      printMathBenchmark();
+    } else if (strcmp(command, "journal") == 0) {
+      Serial.println("OK journal");
+      journal.print(JOURNAL_ENTRIES);
+    } else if (strcmp(command, "model") == 0) {
+      exportModel();
+    } else if (strcmp(command, "prior") == 0) {
+      priorCommand(arg1);
+    } else if (strcmp(command, "selftest") == 0) {
+      selfTestCommand(arg1);
+    } else {
+      Serial.println("ERR commands: get [name] | set <name> <value> | relearn | diag | "
+                     "snapshot | counters | hist [reset] | mathbench | journal | model | "
+                     "prior [begin|<hex>|end|clear] | selftest [step|spike|burst]");
+    }
+  }
+  
+public:
+  void poll() {
+    uint32_t start_us = micros();
+    
+    while (Serial.available() > 0 && micros() - start_us < CMD_POLL_BUDGET_US) {
+      int c = Serial.read();
+      if (c < 0) break;
+      
+      if (c == '\n' || c == '\r') {
+        if (length > 0 && !overflow) {
+          line[length] = '\0';
+          execute(line);
+        } else if (overflow) {
+          Serial.println("ERR line too long");
+        }
+        length = 0;
+        overflow = false;
+      } else if (length < CMD_LINE_MAX - 1) {
+        line[length++] = (char)c;
+      } else {
+        overflow = true;
+      }
+    }
+  }
+};
+
+CommandInterface command_interface;
+
 // ============================================================================
 // SETUP
 // ============================================================================
@@ -546,19 +3955,30 @@ void setup() {
   analogReadResolution(12);  // 12-bit resolution (0-4095)
   pinMode(SENSOR_PIN, INPUT);
   
-  // Initialize sensor buffer
-  for (int i = 0; i < BUFFER_SIZE; i++) {
-    sensor_buffer[i].is_valid = false;
-  }
+  // Initialize sensor buffer and window accumulators (raw extremes start
+  // at +/-FLT_MAX like after any flush, not at 0)
+  flushSensorWindow();
   
   Serial.println("Configuration:");
   Serial.printf("  Sensor Pin: GPIO %d (ADC1_CH6)\n", SENSOR_PIN);
-  Serial.printf("  Sampling Rate: 10 Hz (100ms)\n");
+  Serial.printf("  Sampling Period: %d-%d ms (features every %d ms)\n",
+                SAMPLE_PERIOD_MS, SAMPLE_PERIOD_MAX_MS, UPDATE_INTERVAL_MS);
   Serial.printf("  Learning Duration: %dms\n", LEARNING_DURATION_MS);
   Serial.printf("  Buffer Size: %d samples\n", BUFFER_SIZE);
   Serial.printf("  Feature Window: %d samples\n", FEATURE_WINDOW);
   Serial.println();
   
+#if ENABLE_JOURNAL
+  // What preceded the reset, if anything survived it
+  journal.begin();
+  if (journal.recovered) {
+    Serial.printf("Journal recovered after %s reset:\n",
+                  DecisionJournal::resetReasonName(esp_reset_reason()));
+    journal.print(JOURNAL_BOOT_PRINT);
+    Serial.println();
+  }
+#endif
+  
   enterLearningPhase();
 }
 
@@ -566,35 +3986,296 @@ void setup() {
 // MAIN LOOP
 // ============================================================================
 
-void loop() {
-  uint32_t current_time = millis();
+void processDecision(const AnomalyDecision& decision, uint32_t current_time) {
+  // Everything that follows a live decision, full or gated
+  feature_histograms.record(decision.anomaly_score, current_features);
+  shadow_detectors.evaluate(current_features, decision);
+  sample_rate.update(decision, current_features);
+  updateAdaptiveThreshold();
+  printDecision(decision);
+  printDetailedDiagnostics();
+#if ENABLE_JOURNAL
+  journal.recordDecision(decision, current_time);
+#endif
+  
+  if (tunables.verbosity >= 2 && metrics.total_predictions % HIST_DUMP_INTERVAL == 0) {
+    feature_histograms.dump();
+  }
+}
+
+void processSensorFault(uint32_t current_time, bool changed) {
+  // No features or score while the input is broken; the model is untouched
+  if (sensor_fault.current() == FAULT_NONE) return;  // Suspect sample only: drop it
+  if (changed && tunables.verbosity >= 1) {
+    Serial.printf("[%u ms] Status: SENSOR_FAULT | Reason: %s\n",
+                  current_time, sensor_fault.name());
+  }
+#if ENABLE_JOURNAL
+  if (changed) journal.recordSensorFault(sensor_fault.current(), current_time);
+#endif
+#if ENABLE_SELF_TEST
+  self_test.abort("SENSOR_FAULT");
+#endif
+  if (current_time - last_feature_update >= tunables.update_interval_ms) {
+    last_feature_update = current_time;
+    metrics.sensor_faults++;
+  }
+  sample_rate.reset();  // Watch for recovery at the nominal rate
+}
+
+void processFeatureCycle(uint32_t current_time) {
+  // Every update_interval_ms: one decision (or learning step)
+#if ENABLE_SELF_TEST
+  // Injected fault: score in full, learn and count nothing
+  if (self_test.active()) {
+    if (window_acc.moments.count >= tunables.feature_window) {
+      current_features = extractFeatures();
+      AnomalyDecision decision = scoreCurrentState();
+      sample_rate.update(decision, current_features);
+      if (self_test.observe(decision, current_time)) {
+        flushSensorWindow();
+#if ENABLE_CHANGE_GATE
+        change_gate.disarm();
+#endif
+      }
+    }
+    return;
+  }
+#endif
+  
+#if ENABLE_CHANGE_GATE
+  // Quiet signal: reuse the last decision without scanning the window
+  AnomalyDecision gated;
+  if (!learning_phase_active && change_gate.reuse(current_features, gated)) {
+    learnFromDecision(gated);
+    recordDecision(gated);
+    processDecision(gated, current_time);
+    return;
+  }
+#endif
+  
+  // Extract features
+  current_features = extractFeatures();
+  
+  // Learning phase management
+  if (learning_phase_active) {
+#if ENABLE_CHANGE_GATE
+    change_gate.disarm();  // Baselines are being rebuilt
+#endif
+    shadow_detectors.invalidate();
+    sample_rate.reset();   // Learn at the nominal rate
+    
+    // Cluster and sample every full window
+    if (sensor_samples_collected >= tunables.feature_window &&
+        window_acc.moments.count >= tunables.feature_window) {
+      operating_modes.learn(current_features);
+      training_reservoir.offer(current_features);
+    }
+    
+    if (current_time - learning_start_time >= learningDurationMs()) {
+      completeLearningPhase();
+    }
+  } else if (window_acc.moments.count >= tunables.feature_window) {
+    // Operational phase (skipped while the window refills after a flush)
+    AnomalyDecision decision = classifyCurrentState();
+#if ENABLE_CHANGE_GATE
+    change_gate.arm(current_features, decision, active_mode);
+#endif
+    processDecision(decision, current_time);
+  }
+}
+
+void processSample(int adc_code, uint32_t sample_ms, uint32_t current_time,
+                   uint16_t period_ms, bool check_gap) {
+  // One acquired sample through the pipeline. sample_ms stamps the
+  // conversion, current_time paces the feature cycle; check_gap compares
+  // sample_ms with the previous sample's to account for missed slots
   
-  // Sample sensor at fixed rate
-  float raw_reading = analogRead(SENSOR_PIN) * (3.3 / 4095.0);  // Convert to voltage
+  // Stuck, railed or floating input: keep the sample out of the pipeline
+  SensorFault_t previous_fault = sensor_fault.current();
+  bool skip = sensor_fault.update(adc_code);
+  if (sensor_fault.stuckRunStarting()) sample_rate.reset();  // Confirm at the nominal rate
+  if (skip) {
+    processSensorFault(current_time, sensor_fault.current() != previous_fault);
+    return;
+  }
+  if (previous_fault != FAULT_NONE) {
+    // The window spans the outage: refill it before deciding again
+    flushSensorWindow();
+#if ENABLE_CHANGE_GATE
+    change_gate.disarm();
+#endif
+    if (tunables.verbosity >= 1) {
+      Serial.printf("[%u ms] SENSOR_FAULT cleared\n", current_time);
+    }
+#if ENABLE_JOURNAL
+    journal.recordSensorFault(FAULT_NONE, current_time);
+#endif
+  }
+  
+  float raw_reading = adc_code * (3.3 / 4095.0);  // Convert to voltage
+#if ENABLE_SELF_TEST
+  if (self_test.active()) {
+    raw_reading = self_test.tap(raw_reading);  // Noise floor held while injecting
+  } else {
+    noise_monitor.update(raw_reading);
+  }
+#else
+  noise_monitor.update(raw_reading);
+#endif
   float filtered_reading = sensor_filter.apply(raw_reading);
+#if ENABLE_ENVELOPE
+  envelope_demod.update(adc_code, period_ms);
+#endif
+#if ENABLE_AR_RESIDUAL
+  ar_residual.update(raw_reading, period_ms);
+#endif
   
-  pushSensorReading(raw_reading, filtered_reading);
+  if (check_gap) {
+    pushSensorReading(raw_reading, filtered_reading, period_ms, sample_ms);
+  } else {
+    appendReading(raw_reading, filtered_reading, sample_ms, 0, false);
+  }
   
   // Update features at fixed interval
-  if (current_time - last_feature_update >= UPDATE_INTERVAL_MS) {
+  if (current_time - last_feature_update >= tunables.update_interval_ms) {
     last_feature_update = current_time;
-    
-    // Extract features
-    current_features = extractFeatures();
-    
-    // Learning phase management
-    if (learning_phase_active) {
-      if (current_time - learning_start_time >= LEARNING_DURATION_MS) {
-        completeLearningPhase();
-      }
+    processFeatureCycle(current_time);
+  }
+}
+
+/*
+ * Block ingestion
+ *
+ * processBlock() takes samples already converted at a fixed period, e.g. a
+ * DMA buffer or a replayed recording. While the rate controller runs slower
+ * than that, only every period() / period_ms-th sample is kept, so the
+ * pipeline sees the spacing loop() would have acquired at.
+ *
+ * Kept samples go through in runs of up to BLOCK_RUN_MAX that end on the
+ * sample closing a feature cycle. Each stage sweeps the whole run before
+ * the next starts: fault check; conversion, noise floor, filter and spike
+ * test; envelope; AR; then one counter sweep, one merge of the run's
+ * moments into the window (appendRun), one ADWIN cut test and a copy of
+ * the run into the ring. The stages share no state, so reordering them
+ * this way changes nothing but the rounding of the merged moments, which
+ * stays within float resolution of per-sample processing. Testing ADWIN
+ * once per run is the large saving: its length is only read at a feature
+ * cycle, which always closes a run, so cycles see a tested window; a
+ * change that per-sample testing cuts over several samples is cut once,
+ * which starts the settling hold-out a few samples later. Faults and the
+ * gap-checked first sample of a block fall back to processSample().
+ *
+ * The feature cycle, the AR recursion and the filters still cost the same
+ * per sample, which bounds the gain to about 1.4x on the host.
+ */
+
+int processRun(const uint16_t* codes, int stride, int n, uint32_t t0_ms, uint16_t period_ms) {
+  // Returns the samples consumed: n, or fewer when a fault cut the run
+  static SensorReading_t run[BLOCK_RUN_MAX];
+  
+  if (sensor_fault.current() != FAULT_NONE) {
+    // Inside a fault, or clearing one: per sample
+    processSample(codes[0], t0_ms, t0_ms, period_ms, false);
+    return 1;
+  }
+  int clean = 0;
+  bool faulted = false;
+  while (clean < n && !(faulted = sensor_fault.update(codes[clean * stride]))) {
+    clean++;
+    if (sensor_fault.stuckRunStarting() && sample_rate.period() != period_ms) {
+      // Confirm at the nominal rate: end the run so the stride follows
+      sample_rate.reset();
+      n = clean;
+    }
+  }
+  
+  for (int k = 0; k < clean; k++) {
+    float raw_reading = codes[k * stride] * (3.3 / 4095.0);
+#if ENABLE_SELF_TEST
+    if (self_test.active()) {
+      raw_reading = self_test.tap(raw_reading);
     } else {
-      // Operational phase
-      AnomalyDecision decision = classifyCurrentState();
-      updateAdaptiveThreshold();
-      printDecision(decision);
-      printDetailedDiagnostics();
+      noise_monitor.update(raw_reading);
+    }
+#else
+    noise_monitor.update(raw_reading);
+#endif
+    float filtered_reading = sensor_filter.apply(raw_reading);
+    run[k].raw_value = raw_reading;
+    run[k].filtered_value = filtered_reading;
+    run[k].timestamp = t0_ms + k * period_ms;
+    run[k].missed = 0;
+    run[k].is_interpolated = false;
+    run[k].is_spike = isRawSpike(raw_reading, filtered_reading);
+    run[k].is_valid = true;
+  }
+#if ENABLE_ENVELOPE
+  for (int k = 0; k < clean; k++) envelope_demod.update(codes[k * stride], period_ms);
+#endif
+#if ENABLE_AR_RESIDUAL
+  for (int k = 0; k < clean; k++) ar_residual.update(run[k].raw_value, period_ms);
+#endif
+  appendRun(run, clean);
+  
+  uint32_t t = t0_ms + clean * period_ms;
+  if (faulted) {
+    // sensor_fault has already taken this sample; the run ends here
+    processSensorFault(t, sensor_fault.current() != FAULT_NONE);
+    return clean + 1;
+  }
+  t -= period_ms;
+  if (t - last_feature_update >= tunables.update_interval_ms) {
+    last_feature_update = t;
+    processFeatureCycle(t);
+  }
+  return n;
+}
+
+void processBlock(const uint16_t* codes, size_t n, uint32_t t0_ms, uint16_t period_ms) {
+  // n contiguous samples taken every period_ms from t0_ms; decisions fall
+  // on the same sample boundaries as in loop() at the controller's period
+  command_interface.poll();
+  
+  size_t i = 0;
+  while (i < n) {
+    uint16_t stride = (sample_rate.period() > period_ms) ? sample_rate.period() / period_ms : 1;
+    uint16_t step_ms = period_ms * stride;
+    uint32_t t = t0_ms + (uint32_t)i * period_ms;
+    
+    if (i == 0) {
+      sample_rate.active_samples++;
+      processSample(codes[0], t, t, step_ms, true);
+      i += stride;
+      continue;
     }
+    
+    // Up to and including the sample that closes the next feature cycle
+    size_t left = (n - i + stride - 1) / stride;
+    uint32_t since = t - last_feature_update;
+    size_t to_cycle = (since >= tunables.update_interval_ms) ? 1 :
+                      (tunables.update_interval_ms - since + step_ms - 1) / step_ms + 1;
+    size_t len = (left < to_cycle) ? left : to_cycle;
+    if (len > BLOCK_RUN_MAX) len = BLOCK_RUN_MAX;
+    
+    // Counted up front: the cycle closing the run reports them
+    sample_rate.active_samples += len;
+    size_t used = processRun(codes + i, stride, (int)len, t, step_ms);
+    sample_rate.active_samples -= len - used;
+    i += used * stride;
   }
+}
+
+void loop() {
+  // Apply serial commands between cycles
+  command_interface.poll();
+  
+  uint32_t current_time = millis();
+  
+  // Sample sensor at the current acquisition rate
+  int adc_code = analogRead(SENSOR_PIN);
+  sample_rate.active_samples++;
+  processSample(adc_code, millis(), current_time, sample_rate.period(), true);
   
-  delay(10);  // ~100ms per iteration with processing
+  sample_rate.sleep(current_time);
 }
@@ -0,0 +1,146 @@
+/*
+ * HOST STAND-IN FOR THE ARDUINO CORE
+ * ESP32 Anomaly Detection System
+ *
+ * Just enough of the Arduino API to compile the sketches on Linux:
+ * - millis()/delay() run on a simulated clock (no real sleeping)
+ * - micros() reads the host's monotonic clock, so code timing is real
+ * - analogRead() asks a pluggable signal source for the next ADC code
+ * - Serial writes to stdout (can be silenced) or to a file descriptor such
+ *   as a pseudo-terminal, which then also feeds Serial.read()
+ * - Reset-retained RAM is a file named by SIM_RETAINED_FILE, so it
+ *   survives from one run to the next like RTC memory across a reset;
+ *   the reset reason of the next run is set with SIM_RESET_REASON
+ *
+ * Host programs include this directory first on the include path and then
+ * #include the sketch directly, e.g.
+ *   g++ -std=gnu++17 -O2 -I host host/loop_simulation.cpp -o loop_simulation
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#define INPUT 0
+
+// ============================================================================
+// SIMULATED CLOCK & ADC
+// ============================================================================
+
+inline uint64_t sim_time_us = 0;                       // Simulated time since boot
+inline int (*sim_analog_source)(int pin) = nullptr;    // Returns 12-bit ADC codes
+
+inline uint32_t millis() { return (uint32_t)(sim_time_us / 1000); }
+
+inline uint32_t micros() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)(ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+}
+
+inline void delay(uint32_t ms) { sim_time_us += (uint64_t)ms * 1000; }
+inline void delayMicroseconds(uint32_t us) { sim_time_us += us; }
+
+inline int analogRead(int pin) {
+  return sim_analog_source ? sim_analog_source(pin) : 0;
+}
+inline void analogReadResolution(int) {}
+inline void pinMode(int, int) {}
+
+// ============================================================================
+// RESET REASON & RETAINED MEMORY
+// ============================================================================
+
+typedef enum {
+  ESP_RST_UNKNOWN, ESP_RST_POWERON, ESP_RST_EXT, ESP_RST_SW, ESP_RST_PANIC,
+  ESP_RST_INT_WDT, ESP_RST_TASK_WDT, ESP_RST_WDT, ESP_RST_DEEPSLEEP,
+  ESP_RST_BROWNOUT, ESP_RST_SDIO,
+} esp_reset_reason_t;
+
+inline esp_reset_reason_t esp_reset_reason() {
+  const char* reason = getenv("SIM_RESET_REASON");  // same numbering as ESP-IDF
+  return reason ? (esp_reset_reason_t)atoi(reason) : ESP_RST_POWERON;
+}
+
+// Sketches use RTC_NOINIT_ATTR storage on the board and this on the host
+#define RETAINED_MEMORY(size) hostRetainedMemory(size)
+
+inline void* hostRetainedMemory(size_t size) {
+  const char* path = getenv("SIM_RETAINED_FILE");
+  if (path) {
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd >= 0 && ftruncate(fd, size) == 0) {
+      void* region = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      close(fd);
+      if (region != MAP_FAILED) return region;
+    } else if (fd >= 0) {
+      close(fd);
+    }
+  }
+  return calloc(1, size);  // no file: cleared, as after power-on
+}
+
+// ============================================================================
+// SERIAL
+// ============================================================================
+
+class HostSerial {
+private:
+  void emit(const char* data, size_t len) {
+    if (!echo) return;
+    if (fd >= 0) {
+      if (::write(fd, data, len) < 0) { /* host went away: drop output */ }
+    } else {
+      fwrite(data, 1, len, stdout);
+    }
+  }
+
+public:
+  bool echo = true;  // false silences all sketch output
+  int fd = -1;       // >= 0: read/write this descriptor instead of stdio
+
+  void begin(long) {}
+  void flush() { fflush(stdout); }
+
+  int available() {
+    if (fd < 0) return 0;
+    int pending = 0;
+    return (ioctl(fd, FIONREAD, &pending) == 0) ? pending : 0;
+  }
+  int read() {
+    unsigned char c;
+    if (available() <= 0 || ::read(fd, &c, 1) != 1) return -1;
+    return c;
+  }
+
+  size_t write(uint8_t c) { emit((const char*)&c, 1); return 1; }
+  size_t write(const uint8_t* data, size_t len) { emit((const char*)data, len); return len; }
+
+  void print(const char* s) { emit(s, strlen(s)); }
+  void print(int v) { printf("%d", v); }
+  void println(const char* s = "") { emit(s, strlen(s)); emit("\n", 1); }
+  void println(int v) { printf("%d\n", v); }
+
+  int printf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+    char buffer[256];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buffer, sizeof(buffer), fmt, args);
+    va_end(args);
+    if (n > 0) emit(buffer, (size_t)n < sizeof(buffer) ? (size_t)n : sizeof(buffer) - 1);
+    return n;
+  }
+};
+
+inline HostSerial Serial;
@@ -0,0 +1,165 @@
+/*
+ * BLOCK INGESTION BENCHMARK (LINUX)
+ * ESP32 Anomaly Detection System
+ *
+ * Feeds one recorded signal through the sketch twice, each run in its own
+ * process so both start from a fresh setup():
+ * - loop:  one loop() call per sample, the ADC read served from the recording
+ * - block: processBlock() over consecutive chunks of the same recording
+ *
+ * Fixed sampling, so sample k of both runs carries the same timestamp and
+ * processBlock() keeps every sample.
+ * Reports whether both runs print the same decisions (the sketch output is
+ * captured and hashed, host timing readouts, HIST dumps and the ADWIN and
+ * change-gate counters excluded) and the host time per sample for each
+ * path. processBlock() merges each run into the window moments at once,
+ * which rounds differently from adding its samples one by one, and tests
+ * ADWIN once per run, which counts a change cut over several samples as
+ * one cut and can shift the settling window by a few samples. Either can
+ * move a feature by one histogram bucket or a gate count by one, but
+ * should never change a printed decision.
+ *
+ * Compile: g++ -std=gnu++17 -O2 -I host host/block_benchmark.cpp -o block_benchmark
+ * Usage:   ./block_benchmark [seconds] [block_size]
+ */
+
+#include "../esp32_anomaly_main.cpp"
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <vector>
+
+static uint32_t noise_state = 4242;
+
+static float noise() {
+  noise_state = noise_state * 1664525u + 1013904223u;
+  return ((noise_state >> 8) * (1.0f / 8388608.0f)) - 1.0f;
+}
+
+// Slow baseline wander with a mean step and a variance burst late in the run
+static std::vector<uint16_t> recordSignal(size_t n) {
+  std::vector<uint16_t> codes(n);
+  size_t step_start = n * 6 / 10, step_end = n * 65 / 100;
+  size_t burst_start = n * 8 / 10, burst_end = n * 85 / 100;
+  for (size_t k = 0; k < n; k++) {
+    float t_ms = (float)k * SAMPLE_PERIOD_MS;
+    float code = 2000 + 15 * sin(t_ms * 0.0005f) + 4 * noise();
+    if (k >= step_start && k < step_end) code += 150;
+    if (k >= burst_start && k < burst_end) code += 120 * noise();
+    codes[k] = (uint16_t)fmin(fmax(code, 0), 4095);
+  }
+  return codes;
+}
+
+static const uint16_t* replay_codes = nullptr;
+static size_t replay_next = 0;
+
+static int replaySensor(int) { return replay_codes[replay_next++]; }
+
+// Hash of the sketch output, skipping host timings, histogram dumps and
+// the diagnostic counters the two paths may legitimately disagree on
+static bool skippedLine(const char* line, const char* eol) {
+  static const char* const prefixes[] = {"HIST", "Feature Window:", "Change Gate:"};
+  if (memmem(line, eol - line, "us/eval", 7)) return true;
+  for (const char* prefix : prefixes) {
+    size_t len = strlen(prefix);
+    if ((size_t)(eol - line) >= len && strncmp(line, prefix, len) == 0) return true;
+  }
+  return false;
+}
+
+static uint64_t outputHash(const char* text, size_t len) {
+  uint64_t h = 1469598103934665603ULL;
+  const char* end = text + len;
+  for (const char* line = text; line < end;) {
+    const char* eol = (const char*)memchr(line, '\n', end - line);
+    if (!eol) eol = end;
+    if (!skippedLine(line, eol)) {
+      for (const char* c = line; c < eol; c++) h = (h ^ (uint8_t)*c) * 1099511628211ULL;
+    }
+    line = eol + 1;
+  }
+  return h;
+}
+
+static double nowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+struct RunResult {
+  uint64_t output_hash;
+  uint32_t predictions;
+  uint32_t anomalies;
+  double ns_per_sample;
+};
+
+// One run in a child process; capture=true hashes the sketch output,
+// capture=false runs silent for timing
+static RunResult runChild(const std::vector<uint16_t>& codes, size_t block, bool capture) {
+  RunResult* shared = (RunResult*)mmap(nullptr, sizeof(RunResult), PROT_READ | PROT_WRITE,
+                                       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  pid_t pid = fork();
+  if (pid == 0) {
+    int out = capture ? memfd_create("sketch", 0) : -1;
+    Serial.fd = out;
+    Serial.echo = capture;
+    replay_codes = codes.data();
+    sim_analog_source = replaySensor;
+    setup();
+    sample_rate.adaptive = false;
+
+    size_t n = codes.size();
+    double start = nowNs();
+    if (block == 0) {
+      while (replay_next < n) loop();
+    } else {
+      uint32_t t0 = millis();
+      for (size_t i = 0; i < n; i += block) {
+        size_t len = (n - i < block) ? n - i : block;
+        processBlock(codes.data() + i, len, t0 + (uint32_t)i * SAMPLE_PERIOD_MS,
+                     SAMPLE_PERIOD_MS);
+      }
+    }
+    shared->ns_per_sample = (nowNs() - start) / n;
+    shared->predictions = metrics.total_predictions;
+    shared->anomalies = metrics.anomalies_detected;
+    shared->output_hash = 0;
+    if (capture) {
+      off_t len = lseek(out, 0, SEEK_END);
+      std::vector<char> text(len);
+      if (pread(out, text.data(), len, 0) == len) shared->output_hash = outputHash(text.data(), len);
+    }
+    _exit(0);
+  }
+  waitpid(pid, nullptr, 0);
+  RunResult result = *shared;
+  munmap(shared, sizeof(RunResult));
+  return result;
+}
+
+int main(int argc, char** argv) {
+  uint32_t seconds = (argc > 1) ? (uint32_t)atoi(argv[1]) : 300;
+  size_t block = (argc > 2) ? (size_t)atoi(argv[2]) : 64;
+  if (block == 0) block = 1;
+
+  std::vector<uint16_t> codes = recordSignal((size_t)seconds * 1000 / SAMPLE_PERIOD_MS);
+  printf("Recording: %zu samples (%u s at %d ms) | block size %zu\n",
+         codes.size(), seconds, SAMPLE_PERIOD_MS, block);
+
+  RunResult loop_check = runChild(codes, 0, true);
+  RunResult block_check = runChild(codes, block, true);
+  bool same = loop_check.output_hash == block_check.output_hash &&
+              loop_check.predictions == block_check.predictions &&
+              loop_check.anomalies == block_check.anomalies;
+  printf("Decisions: loop %u (%u anomalies) | block %u (%u anomalies) | output %s\n",
+         loop_check.predictions, loop_check.anomalies, block_check.predictions,
+         block_check.anomalies, same ? "identical" : "DIFFERS");
+
+  RunResult loop_time = runChild(codes, 0, false);
+  RunResult block_time = runChild(codes, block, false);
+  printf("Time per sample: loop %.0f ns | block %.0f ns | %.2fx\n", loop_time.ns_per_sample,
+         block_time.ns_per_sample, loop_time.ns_per_sample / block_time.ns_per_sample);
+  return same ? 0 : 1;
+}
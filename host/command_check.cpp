@@ -0,0 +1,167 @@
+/*
+ * COMMAND INTERFACE CHECK (LINUX)
+ * ESP32 Anomaly Detection System
+ *
+ * Drives the sketch's serial command interface through
+ * command_interface.poll(), the same entry point loop() uses, with Serial
+ * attached to one end of a socket pair, and checks every reply:
+ * - get: all tunables, one tunable, an unknown one
+ * - set: a float and an integer tunable, out-of-range, malformed and
+ *   (for an integer tunable) fractional or negative values, which must be
+ *   refused with the tunable unchanged, and an unknown tunable
+ * - an unknown command, an overlong line
+ * - set feature_window: learning restarts, the window is flushed, and the
+ *   first refilled window agrees with a rescan of the samples
+ * - journal: the relearn gets its own LEARNED entry, stamped with the
+ *   time of the decision that records it
+ * Exits non-zero if any check fails.
+ *
+ * Compile: g++ -std=gnu++17 -O2 -I host host/command_check.cpp -o command_check
+ * Usage:   ./command_check
+ */
+
+#include "../esp32_anomaly_main.cpp"
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <string>
+
+static int host_end = -1;
+static int failures = 0;
+static uint32_t noise_state = 99;
+
+static int syntheticSensor(int) {
+  noise_state = noise_state * 1664525u + 1013904223u;
+  float noise = ((noise_state >> 8) * (1.0f / 8388608.0f)) - 1.0f;
+  return (int)(2000 + 15 * sin(millis() * 0.0005f) + 4 * noise);
+}
+
+// Everything the sketch has written since the last call
+static std::string drain() {
+  std::string text;
+  char chunk[4096];
+  ssize_t n;
+  while ((n = read(host_end, chunk, sizeof(chunk))) > 0) text.append(chunk, n);
+  return text;
+}
+
+// One command line in, its reply out
+static std::string command(const std::string& line) {
+  drain();
+  std::string input = line + "\n";
+  if (write(host_end, input.data(), input.size()) != (ssize_t)input.size()) return "";
+  command_interface.poll();
+  return drain();
+}
+
+static void expect(const char* what, bool pass, const std::string& reply) {
+  printf("%-44s %s\n", what, pass ? "PASS" : "FAIL");
+  if (!pass) {
+    printf("  reply: %s", reply.empty() ? "(none)\n" : reply.c_str());
+    failures++;
+  }
+}
+
+static bool startsWith(const std::string& text, const char* prefix) {
+  return text.compare(0, strlen(prefix), prefix) == 0;
+}
+
+static int countLines(const std::string& text, const char* prefix) {
+  int count = 0;
+  for (size_t at = 0; at < text.size();) {
+    size_t eol = text.find('\n', at);
+    if (eol == std::string::npos) eol = text.size();
+    if (text.compare(at, strlen(prefix), prefix) == 0) count++;
+    at = eol + 1;
+  }
+  return count;
+}
+
+int main() {
+  int pair[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+    perror("socketpair");
+    return 1;
+  }
+  host_end = pair[1];
+  fcntl(host_end, F_SETFL, fcntl(host_end, F_GETFL) | O_NONBLOCK);
+  Serial.fd = pair[0];
+  sim_analog_source = syntheticSensor;
+  setup();
+  drain();
+
+  std::string reply;
+
+  reply = command("get");
+  expect("get lists every tunable", countLines(reply, "OK ") == NUM_TUNABLES, reply);
+  reply = command("get filter_alpha");
+  expect("get filter_alpha", reply == "OK filter_alpha=0.2000\n", reply);
+  reply = command("get no_such");
+  expect("get unknown tunable", reply == "ERR unknown tunable 'no_such'\n", reply);
+
+  reply = command("set filter_alpha 0.35");
+  expect("set filter_alpha 0.35", reply == "OK filter_alpha=0.3500\n" &&
+                                  fabs(tunables.filter_alpha - 0.35f) < 1e-6, reply);
+  reply = command("set filter_alpha 5");
+  expect("set filter_alpha out of range is refused",
+         startsWith(reply, "ERR filter_alpha must be a number in") &&
+         fabs(tunables.filter_alpha - 0.35f) < 1e-6, reply);
+  reply = command("set filter_alpha 0.3x");
+  expect("set filter_alpha malformed is refused",
+         startsWith(reply, "ERR filter_alpha must be a number in") &&
+         fabs(tunables.filter_alpha - 0.35f) < 1e-6, reply);
+  reply = command("set verbosity 0");
+  expect("set verbosity 0", reply == "OK verbosity=0\n" && tunables.verbosity == 0, reply);
+  uint16_t window = tunables.feature_window;
+  reply = command("set feature_window 37.9");
+  expect("set feature_window fractional is refused",
+         startsWith(reply, "ERR feature_window must be an integer in") &&
+         tunables.feature_window == window, reply);
+  reply = command("set feature_window -5");
+  expect("set feature_window negative is refused",
+         startsWith(reply, "ERR feature_window must be an integer in") &&
+         tunables.feature_window == window, reply);
+  reply = command("set no_such 1");
+  expect("set unknown tunable", reply == "ERR unknown tunable 'no_such'\n", reply);
+  reply = command("frobnicate");
+  expect("unknown command lists the commands", startsWith(reply, "ERR commands:"), reply);
+  reply = command(std::string(CMD_LINE_MAX + 10, 'x'));
+  expect("overlong line", reply == "ERR line too long\n", reply);
+
+  // Run into the operational phase, then shrink the window
+  while (learning_phase_active) loop();
+  for (int i = 0; i < 500; i++) loop();
+  reply = command("set feature_window 30");
+  expect("set feature_window 30 restarts learning",
+         startsWith(reply, "OK feature_window=30\n") && learning_phase_active &&
+         tunables.feature_window == 30, reply);
+  expect("set feature_window flushes the window",
+         window_acc.moments.count == 0 && getValidSamplesCount() == 0, reply);
+
+  // First full window at the new length: the O(1) moments match a rescan
+  while (window_acc.moments.count < 30) loop();
+  SampleStats scan = windowStats(0, 30);
+  bool same = window_acc.moments.count == scan.count &&
+              fabs(window_acc.moments.mean - scan.mean) < 1e-5 &&
+              fabs(window_acc.moments.variance() - scan.variance()) < 1e-8;
+  char detail[128];
+  snprintf(detail, sizeof(detail), "moments n=%u mean=%.6f | rescan n=%u mean=%.6f\n",
+           window_acc.moments.count, window_acc.moments.mean, scan.count, scan.mean);
+  expect("first window after resize matches a rescan", same, detail);
+  
+  // Relearned: the first decision after it journals the new threshold
+  uint32_t relearn_start = learning_start_time;
+  while (learning_phase_active) loop();
+  uint32_t before = metrics.total_predictions;
+  while (metrics.total_predictions == before) loop();
+  reply = command("journal");
+  size_t at = reply.rfind(" LEARNED");
+  size_t stamp = (at == std::string::npos) ? at : reply.rfind('[', at);
+  uint32_t learned_ms = (stamp == std::string::npos) ? 0 : (uint32_t)atol(reply.c_str() + stamp + 1);
+  expect("journal records the relearned threshold",
+         countLines(reply, "  #") > 0 && learned_ms == last_feature_update &&
+         learned_ms >= relearn_start + learningDurationMs(), reply);
+
+  printf("\n%s\n", failures ? "FAILED" : "All command checks passed");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,333 @@
+/*
+ * FLEET PRIOR BUILDER (LINUX)
+ * ESP32 Anomaly Detection System
+ *
+ * Reads serial logs containing MODEL-BEGIN / MODE / MODEL-END exports
+ * (the "model" command), one device per log with its last complete export
+ * winning, and reduces them per sensor type to a prior blob:
+ * - Modes of all devices are pooled and leader-clustered with the sketch's
+ *   MODE_LEADER_RADIUS, best-supported modes first, one mode per device
+ *   per cluster; the NUM_OPERATING_MODES clusters seen on the most devices
+ *   are kept if they reach the support fraction (-s)
+ * - Baselines are the medians across devices; range bounds are offsets
+ *   from each device's baseline, widened by -k robust standard deviations
+ *   (1.4826 x MAD), so one odd device cannot stretch them
+ * - The threshold is the median adaptive threshold
+ * Logs are parsed and the per-column medians reduced on -t worker threads.
+ *
+ * The report goes to stderr. Each type's prior goes to stdout as
+ * "prior begin" / "prior <hex>" / "prior end" console lines under a
+ * "# type=..." header; -T selects one type and drops the header, so the
+ * output can be sent to a device as is.
+ *
+ * Compile: g++ -std=gnu++17 -O2 -pthread -I host host/fleet_prior.cpp -o fleet_prior
+ * Usage:   ./fleet_prior [-t threads] [-k mads] [-s support] [-T type] device1.log ...
+ */
+
+#include "../esp32_anomaly_main.cpp"
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Column layout per cluster: 3 baselines, then lower/upper offsets per feature
+#define PRIOR_COLUMNS 9
+#define PRIOR_CHUNK_BYTES ((CMD_LINE_MAX - 1 - 6) / 2)  // "prior " + hex fits a line
+
+struct ModeExport {
+  uint32_t windows;
+  float baseline[3];       // mean, std_dev, rms
+  float range[3][2];
+
+  float column(int c) const {
+    if (c < 3) return baseline[c];
+    int f = (c - 3) / 2;
+    return range[f][(c - 3) % 2] - baseline[f];
+  }
+};
+
+struct DeviceExport {
+  std::string type;
+  float threshold = 0;
+  std::vector<ModeExport> modes;
+};
+
+struct ModeCluster {
+  float leader[2];                 // mean, std_dev of the leading mode
+  std::vector<const ModeExport*> members;
+  std::vector<int> devices;
+  float median[PRIOR_COLUMNS] = {0};
+  float mad[PRIOR_COLUMNS] = {0};
+};
+
+struct TypePrior {
+  std::string type;
+  std::vector<const DeviceExport*> devices;
+  std::vector<ModeCluster> clusters;  // kept clusters only
+  int dropped = 0;
+  float threshold = 0;
+};
+
+// ============================================================================
+// PARSING
+// ============================================================================
+
+static bool parseLog(const char* path, DeviceExport& out) {
+  FILE* in = fopen(path, "r");
+  if (!in) {
+    perror(path);
+    return false;
+  }
+
+  char line[512];
+  DeviceExport current;
+  bool open = false, found = false;
+  while (fgets(line, sizeof(line), in)) {
+    char type[32];
+    int modes;
+    char* begin = strstr(line, "MODEL-BEGIN ");
+    if (begin) {
+      current = DeviceExport();
+      open = sscanf(begin, "MODEL-BEGIN type=%31s modes=%d thr=%f",
+                    type, &modes, &current.threshold) == 3;
+      current.type = type;
+      continue;
+    }
+    if (!open) continue;
+    if (strstr(line, "MODEL-END")) {
+      open = false;
+      if (!current.modes.empty()) {
+        out = current;
+        found = true;
+      }
+      continue;
+    }
+
+    char* mode = strstr(line, "MODE ");
+    if (!mode) continue;
+    ModeExport m;
+    int idx;
+    if (sscanf(mode, "MODE %d n=%u mean=%f std=%f rms=%f r=%f,%f,%f,%f,%f,%f", &idx, &m.windows,
+               &m.baseline[0], &m.baseline[1], &m.baseline[2], &m.range[0][0], &m.range[0][1],
+               &m.range[1][0], &m.range[1][1], &m.range[2][0], &m.range[2][1]) == 11) {
+      current.modes.push_back(m);
+    } else {
+      open = false;  // garbled export: keep the previous one
+    }
+  }
+  fclose(in);
+  return found;
+}
+
+// ============================================================================
+// REDUCTION
+// ============================================================================
+
+static void clusterModes(TypePrior& prior, float support) {
+  std::vector<std::pair<const ModeExport*, int>> pooled;
+  for (int d = 0; d < (int)prior.devices.size(); d++) {
+    for (const ModeExport& m : prior.devices[d]->modes) pooled.push_back({&m, d});
+  }
+  std::stable_sort(pooled.begin(), pooled.end(), [](const auto& a, const auto& b) {
+    return a.first->windows > b.first->windows;
+  });
+
+  std::vector<ModeCluster> clusters;
+  for (const auto& [mode, device] : pooled) {
+    int best = -1;
+    float best_dist = MODE_LEADER_RADIUS * MODE_LEADER_RADIUS;
+    for (int c = 0; c < (int)clusters.size(); c++) {
+      float d_mean = mode->baseline[0] - clusters[c].leader[0];
+      float d_std = mode->baseline[1] - clusters[c].leader[1];
+      float dist = d_mean * d_mean + d_std * d_std;
+      if (dist <= best_dist) {
+        best_dist = dist;
+        best = c;
+      }
+    }
+    if (best < 0) {
+      ModeCluster cluster;
+      cluster.leader[0] = mode->baseline[0];
+      cluster.leader[1] = mode->baseline[1];
+      clusters.push_back(cluster);
+      best = clusters.size() - 1;
+    }
+    ModeCluster& cluster = clusters[best];
+    if (std::find(cluster.devices.begin(), cluster.devices.end(), device) != cluster.devices.end()) {
+      continue;  // a device's weaker duplicate of a mode it already placed
+    }
+    cluster.members.push_back(mode);
+    cluster.devices.push_back(device);
+  }
+
+  std::stable_sort(clusters.begin(), clusters.end(), [](const ModeCluster& a, const ModeCluster& b) {
+    return a.devices.size() > b.devices.size();
+  });
+  size_t min_devices = (size_t)ceil(support * prior.devices.size());
+  for (ModeCluster& cluster : clusters) {
+    if ((int)prior.clusters.size() < NUM_OPERATING_MODES &&
+        cluster.devices.size() >= std::max<size_t>(min_devices, 1)) {
+      prior.clusters.push_back(cluster);
+    } else {
+      prior.dropped++;
+    }
+  }
+}
+
+static void medianMad(std::vector<float>& values, float& median, float& mad) {
+  auto middle = values.begin() + values.size() / 2;
+  std::nth_element(values.begin(), middle, values.end());
+  median = *middle;
+  for (float& v : values) v = fabs(v - median);
+  std::nth_element(values.begin(), middle, values.end());
+  mad = *middle;
+}
+
+static void reduceColumns(std::vector<TypePrior>& priors, int threads) {
+  // One job per (type, cluster, column) and one per type threshold
+  struct Job {
+    TypePrior* prior;
+    ModeCluster* cluster;  // NULL: the type's threshold
+    int column;
+  };
+  std::vector<Job> jobs;
+  for (TypePrior& prior : priors) {
+    jobs.push_back({&prior, NULL, 0});
+    for (ModeCluster& cluster : prior.clusters) {
+      for (int c = 0; c < PRIOR_COLUMNS; c++) jobs.push_back({&prior, &cluster, c});
+    }
+  }
+
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> workers;
+  for (int w = 0; w < threads; w++) {
+    workers.emplace_back([&]() {
+      std::vector<float> values;
+      for (size_t j; (j = next.fetch_add(1)) < jobs.size();) {
+        const Job& job = jobs[j];
+        values.clear();
+        float unused;
+        if (job.cluster == NULL) {
+          for (const DeviceExport* d : job.prior->devices) values.push_back(d->threshold);
+          medianMad(values, job.prior->threshold, unused);
+        } else {
+          for (const ModeExport* m : job.cluster->members) values.push_back(m->column(job.column));
+          medianMad(values, job.cluster->median[job.column], job.cluster->mad[job.column]);
+        }
+      }
+    });
+  }
+  for (std::thread& t : workers) t.join();
+}
+
+static FleetPrior_t buildBlob(const TypePrior& prior, float mads) {
+  FleetPrior_t blob;
+  memset(&blob, 0, sizeof(blob));
+  blob.mode_count = prior.clusters.size();
+  blob.devices = std::min<size_t>(prior.devices.size(), 65535);
+  blob.threshold = prior.threshold;
+  for (int i = 0; i < blob.mode_count; i++) {
+    const ModeCluster& cluster = prior.clusters[i];
+    PriorMode_t& mode = blob.modes[i];
+    for (int f = 0; f < 3; f++) {
+      mode.baseline[f] = cluster.median[f];
+      int lo = 3 + 2 * f, hi = lo + 1;
+      mode.offsets[f][0] = cluster.median[lo] - mads * 1.4826f * cluster.mad[lo];
+      mode.offsets[f][1] = cluster.median[hi] + mads * 1.4826f * cluster.mad[hi];
+    }
+  }
+  FleetPrior::seal(blob, prior.type.c_str());
+  return blob;
+}
+
+static void printCommands(const FleetPrior_t& blob) {
+  const uint8_t* bytes = (const uint8_t*)&blob;
+  printf("prior begin\n");
+  for (size_t i = 0; i < sizeof(blob); i += PRIOR_CHUNK_BYTES) {
+    printf("prior ");
+    for (size_t b = i; b < sizeof(blob) && b < i + PRIOR_CHUNK_BYTES; b++) printf("%02x", bytes[b]);
+    printf("\n");
+  }
+  printf("prior end\n");
+}
+
+// ============================================================================
+// DRIVER
+// ============================================================================
+
+int main(int argc, char** argv) {
+  int threads = (int)std::thread::hardware_concurrency();
+  float mads = 3.0f;
+  float support = 0.25f;
+  const char* only_type = NULL;
+  std::vector<const char*> paths;
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 < argc && strcmp(argv[i], "-t") == 0) threads = atoi(argv[++i]);
+    else if (i + 1 < argc && strcmp(argv[i], "-k") == 0) mads = atof(argv[++i]);
+    else if (i + 1 < argc && strcmp(argv[i], "-s") == 0) support = atof(argv[++i]);
+    else if (i + 1 < argc && strcmp(argv[i], "-T") == 0) only_type = argv[++i];
+    else paths.push_back(argv[i]);
+  }
+  if (paths.empty()) {
+    fprintf(stderr, "usage: %s [-t threads] [-k mads] [-s support] [-T type] "
+                    "device1.log ...\n", argv[0]);
+    return 1;
+  }
+  if (threads < 1) threads = 1;
+
+  // Parse logs in parallel, one slot per log
+  std::vector<DeviceExport> exports(paths.size());
+  std::vector<char> found(paths.size(), 0);
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> workers;
+  for (int w = 0; w < threads; w++) {
+    workers.emplace_back([&]() {
+      for (size_t i; (i = next.fetch_add(1)) < paths.size();) found[i] = parseLog(paths[i], exports[i]);
+    });
+  }
+  for (std::thread& t : workers) t.join();
+
+  std::vector<TypePrior> priors;
+  int devices = 0;
+  for (size_t i = 0; i < paths.size(); i++) {
+    if (!found[i]) continue;
+    if (only_type && exports[i].type != only_type) continue;
+    devices++;
+    auto it = std::find_if(priors.begin(), priors.end(),
+                           [&](const TypePrior& p) { return p.type == exports[i].type; });
+    if (it == priors.end()) {
+      priors.push_back(TypePrior());
+      priors.back().type = exports[i].type;
+      it = priors.end() - 1;
+    }
+    it->devices.push_back(&exports[i]);
+  }
+
+  fprintf(stderr, "Exports: %d devices from %zu logs | %zu types | threads = %d\n",
+          devices, paths.size(), priors.size(), threads);
+  if (priors.empty()) return 1;
+
+  for (TypePrior& prior : priors) clusterModes(prior, support);
+  reduceColumns(priors, threads);
+
+  for (const TypePrior& prior : priors) {
+    FleetPrior_t blob = buildBlob(prior, mads);
+    fprintf(stderr, "Type %s: %zu devices | threshold %.4f | %zu modes (%d dropped below "
+            "%.0f%% support) | %zu byte blob\n", prior.type.c_str(), prior.devices.size(),
+            prior.threshold, prior.clusters.size(), prior.dropped, support * 100, sizeof(blob));
+    for (int i = 0; i < blob.mode_count; i++) {
+      const PriorMode_t& mode = blob.modes[i];
+      fprintf(stderr, "  mode %d: %zu devices | mean %.4f %+.4f/%+.4f | std %.4f %+.4f/%+.4f | "
+              "rms %.4f %+.4f/%+.4f\n", i, prior.clusters[i].devices.size(),
+              mode.baseline[0], mode.offsets[0][0], mode.offsets[0][1],
+              mode.baseline[1], mode.offsets[1][0], mode.offsets[1][1],
+              mode.baseline[2], mode.offsets[2][0], mode.offsets[2][1]);
+    }
+    if (blob.mode_count == 0) continue;
+    if (!only_type) printf("# type=%s devices=%zu\n", prior.type.c_str(), prior.devices.size());
+    printCommands(blob);
+  }
+  return 0;
+}
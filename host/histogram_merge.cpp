@@ -0,0 +1,120 @@
+/*
+ * HISTOGRAM MERGE TOOL (LINUX)
+ * ESP32 Anomaly Detection System
+ *
+ * Reads serial logs containing HIST-BEGIN / HIST / HIST-END dumps from any
+ * number of devices or sessions, adds the bucket counts per histogram name,
+ * and prints:
+ * - The merged histograms in the same HIST format (so merges compose)
+ * - p50 / p90 / p99 bucket lower bounds per histogram
+ * - The share of anomaly scores at or above the last reported threshold
+ *
+ * Dumps with a different bucket layout than this build are skipped.
+ *
+ * Compile: g++ -std=gnu++17 -O2 -I host host/histogram_merge.cpp -o histogram_merge
+ * Usage:   ./histogram_merge device1.log device2.log ...   (or stdin)
+ */
+
+#include "../esp32_anomaly_main.cpp"
+
+#define MAX_HISTOGRAMS 16
+
+struct NamedHistogram {
+  char name[16];
+  LogLinearHistogram histogram;
+};
+
+static NamedHistogram merged[MAX_HISTOGRAMS];
+static int num_merged = 0;
+static float last_threshold = -1;
+static uint32_t dumps_merged = 0, dumps_skipped = 0;
+
+static LogLinearHistogram* lookup(const char* name) {
+  for (int i = 0; i < num_merged; i++) {
+    if (strcmp(merged[i].name, name) == 0) return &merged[i].histogram;
+  }
+  if (num_merged == MAX_HISTOGRAMS) return NULL;
+  snprintf(merged[num_merged].name, sizeof(merged[num_merged].name), "%s", name);
+  return &merged[num_merged++].histogram;
+}
+
+static void mergeStream(FILE* in) {
+  char line[4096];
+  bool layout_ok = false;
+
+  while (fgets(line, sizeof(line), in)) {
+    int bits, min_exp, max_exp;
+    float threshold;
+    char* begin = strstr(line, "HIST-BEGIN ");
+    if (begin) {
+      const char* layout = strstr(begin, "layout=");
+      layout_ok = layout && sscanf(layout, "layout=%d,%d,%d", &bits, &min_exp, &max_exp) == 3 &&
+                  bits == HIST_SUB_BUCKET_BITS && min_exp == HIST_MIN_EXP &&
+                  max_exp == HIST_MAX_EXP;
+      const char* thr = strstr(begin, "thr=");
+      if (layout_ok && thr && sscanf(thr, "thr=%f", &threshold) == 1) last_threshold = threshold;
+      if (layout_ok) dumps_merged++;
+      else dumps_skipped++;
+      continue;
+    }
+
+    char* hist = strstr(line, "HIST ");
+    if (!hist || !layout_ok) continue;
+
+    // HIST <name> n=<total> <index>:<count> ...
+    char* save;
+    strtok_r(hist, " \t\r\n", &save);
+    char* name = strtok_r(NULL, " \t\r\n", &save);
+    strtok_r(NULL, " \t\r\n", &save);  // n=<total>, recomputed from buckets
+    LogLinearHistogram* target = name ? lookup(name) : NULL;
+    if (!target) continue;
+
+    for (char* tok; (tok = strtok_r(NULL, " \t\r\n", &save)) != NULL;) {
+      int idx;
+      unsigned count;
+      if (sscanf(tok, "%d:%u", &idx, &count) == 2 &&
+          idx >= 0 && idx < LogLinearHistogram::NUM_BUCKETS) {
+        target->add(idx, count);
+      }
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    mergeStream(stdin);
+  }
+  for (int i = 1; i < argc; i++) {
+    FILE* in = fopen(argv[i], "r");
+    if (!in) {
+      perror(argv[i]);
+      continue;
+    }
+    mergeStream(in);
+    fclose(in);
+  }
+
+  printf("Merged %u dumps (%u skipped: layout mismatch)\n", dumps_merged, dumps_skipped);
+  printf("HIST-BEGIN t=0 thr=%.4f layout=%d,%d,%d\n", last_threshold,
+         HIST_SUB_BUCKET_BITS, HIST_MIN_EXP, HIST_MAX_EXP);
+  for (int i = 0; i < num_merged; i++) merged[i].histogram.dump(merged[i].name);
+  printf("HIST-END\n\n");
+
+  for (int i = 0; i < num_merged; i++) {
+    const LogLinearHistogram& h = merged[i].histogram;
+    printf("%-8s n=%-8u p50>=%-10.5g p90>=%-10.5g p99>=%-10.5g\n", merged[i].name,
+           h.totalCount(), h.quantile(0.50f), h.quantile(0.90f), h.quantile(0.99f));
+  }
+
+  LogLinearHistogram* score = lookup("score");
+  if (score && score->totalCount() > 0 && last_threshold >= 0) {
+    uint32_t above = 0;
+    for (int i = LogLinearHistogram::bucketIndex(last_threshold);
+         i < LogLinearHistogram::NUM_BUCKETS; i++) {
+      above += score->count(i);
+    }
+    printf("\nScores in or above the threshold bucket (%.3f): %.2f%%\n",
+           last_threshold, 100.0f * above / score->totalCount());
+  }
+  return 0;
+}
@@ -0,0 +1,216 @@
+/*
+ * MAIN LOOP SIMULATION (LINUX)
+ * ESP32 Anomaly Detection System
+ *
+ * Runs the unmodified sketch against a synthetic sensor on a simulated
+ * clock and reports:
+ * - Power proxy: ADC conversions (active samples) per simulated second
+ * - Detection latency: time from fault onset to the first ANOMALY decision,
+ *   and settling: time from fault end to the last ANOMALY decision
+ * - False alarms: anomaly decisions outside fault windows
+ * - Sensor health: decisions taken while the noise floor was flagged, the
+ *   time from a degrading sensor (rising input noise) to NOISE_FLOOR_RISE,
+ *   a check that no process fault raises it, and the time from each
+ *   injected input fault to SENSOR_FAULT
+ * - Overload: samples missed while loop() is made to stall
+ * - Shadow detector tallies against the live decisions
+ *
+ * Compile: g++ -std=gnu++17 -O2 -I host host/loop_simulation.cpp -o loop_simulation
+ * Usage:   ./loop_simulation [fixed|adaptive] [seconds]
+ */
+
+#include "../esp32_anomaly_main.cpp"
+
+// ============================================================================
+// SYNTHETIC SENSOR
+// ============================================================================
+
+struct Fault {
+  const char* name;
+  uint32_t start_ms;
+  uint32_t end_ms;
+};
+
+static const Fault faults[] = {
+  {"mean step",      300000, 320000},
+  {"variance burst", 450000, 470000},
+  {"slow drift",     600000, 660000},
+  {"modulation",     680000, 700000},
+};
+static const int NUM_FAULTS = sizeof(faults) / sizeof(faults[0]);
+
+// Broken-input faults: not process anomalies, expected as SENSOR_FAULT
+static const Fault input_faults[] = {
+  {"stuck code", 520000, 525000},
+  {"rail low",   540000, 545000},
+  {"floating",   560000, 565000},
+};
+static const int NUM_INPUT_FAULTS = sizeof(input_faults) / sizeof(input_faults[0]);
+
+// Sensor degradation: input noise rises from 4 to NOISE_RISE_CODES, expected
+// as NOISE_FLOOR_RISE; anomaly decisions inside it are not false alarms
+static const Fault noise_rise = {"noise rise", 200000, 260000};
+#define NOISE_RISE_CODES 10
+
+// Overload: every ADC read blocks for this long inside the window
+static const Fault loop_stall = {"loop stall", 380000, 390000};
+#define STALL_EXTRA_MS 25
+
+static uint32_t noise_state = 12345;
+
+static float noise() {
+  // Uniform in [-1, 1), deterministic across runs
+  noise_state = noise_state * 1664525u + 1013904223u;
+  return ((noise_state >> 8) * (1.0f / 8388608.0f)) - 1.0f;
+}
+
+static int syntheticSensor(int) {
+  static int last_code = 2000;
+  if (millis() >= loop_stall.start_ms && millis() < loop_stall.end_ms) delay(STALL_EXTRA_MS);
+  float t_ms = millis();
+
+  if (t_ms >= input_faults[0].start_ms && t_ms < input_faults[0].end_ms) return last_code;
+  if (t_ms >= input_faults[1].start_ms && t_ms < input_faults[1].end_ms) return 0;
+  if (t_ms >= input_faults[2].start_ms && t_ms < input_faults[2].end_ms) {
+    return (noise() > 0) ? 4095 - (int)(600 * fabs(noise())) : (int)(600 * fabs(noise()));
+  }
+
+  bool degraded = t_ms >= noise_rise.start_ms && t_ms < noise_rise.end_ms;
+  float code = 2000 + 15 * sin(t_ms * 0.0005f) + (degraded ? NOISE_RISE_CODES : 4) * noise();
+
+  if (t_ms >= faults[0].start_ms && t_ms < faults[0].end_ms) code += 150;
+  if (t_ms >= faults[1].start_ms && t_ms < faults[1].end_ms) code += 120 * noise();
+  if (t_ms >= faults[2].start_ms && t_ms < faults[2].end_ms) {
+    code += (t_ms - faults[2].start_ms) * 0.01f;
+  }
+  if (t_ms >= faults[3].start_ms && t_ms < faults[3].end_ms) {
+    // 25 Hz resonance struck at 5 Hz, as by a bearing defect
+    float strike = 0.5f * (1 + cos(2 * M_PI * 5 * t_ms / 1000));
+    code += 8 * strike * sin(2 * M_PI * 25 * t_ms / 1000);
+  }
+
+  if (code < 0) code = 0;
+  if (code > 4095) code = 4095;
+  last_code = (int)code;
+  return last_code;
+}
+
+// ============================================================================
+// DRIVER
+// ============================================================================
+
+int main(int argc, char** argv) {
+  bool adaptive = !(argc > 1 && strcmp(argv[1], "fixed") == 0);
+  uint32_t duration_ms = (argc > 2) ? (uint32_t)atoi(argv[2]) * 1000 : 720000;
+
+  sim_analog_source = syntheticSensor;
+  Serial.echo = false;
+
+  setup();
+  sample_rate.adaptive = adaptive;
+
+  uint32_t detection_ms[NUM_FAULTS], last_anomaly_ms[NUM_FAULTS];
+  for (int i = 0; i < NUM_FAULTS; i++) detection_ms[i] = last_anomaly_ms[i] = 0;
+  uint32_t input_detection_ms[NUM_INPUT_FAULTS];
+  for (int i = 0; i < NUM_INPUT_FAULTS; i++) input_detection_ms[i] = 0;
+  uint32_t false_alarms = 0;
+  uint32_t noise_rise_ms = 0, noise_rise_anomalies = 0;
+  uint32_t flagged_in_faults = 0, last_flagged = 0;
+  uint32_t operational_samples = 0;
+  uint32_t operational_start_ms = 0;
+  uint32_t last_anomalies = 0;
+
+  while (millis() < duration_ms) {
+    uint32_t samples_before = sample_rate.active_samples;
+    loop();
+
+    for (int i = 0; i < NUM_INPUT_FAULTS; i++) {
+      if (sensor_fault.current() != FAULT_NONE && input_detection_ms[i] == 0 &&
+          millis() >= input_faults[i].start_ms && millis() < input_faults[i].end_ms) {
+        input_detection_ms[i] = millis();
+      }
+    }
+
+    if (learning_phase_active) continue;
+    if (operational_start_ms == 0) operational_start_ms = millis();
+    operational_samples += sample_rate.active_samples - samples_before;
+    
+    // Sensor health flags: expected in the noise rise, never in a process fault
+    if (metrics.sensor_degraded != last_flagged) {
+      last_flagged = metrics.sensor_degraded;
+      uint32_t now = millis();
+      if (noise_rise_ms == 0 && now >= noise_rise.start_ms && now < noise_rise.end_ms) {
+        noise_rise_ms = now;
+      }
+      for (int i = 0; i < NUM_FAULTS; i++) {
+        if (now >= faults[i].start_ms && now < faults[i].end_ms + 5000) flagged_in_faults++;
+      }
+    }
+
+    if (metrics.anomalies_detected == last_anomalies) continue;
+    last_anomalies = metrics.anomalies_detected;
+
+    // Attribute the anomaly decision to the fault it falls in (plus one
+    // feature window of tail after the fault ends)
+    uint32_t now = millis();
+    bool attributed = false;
+    if (now >= noise_rise.start_ms && now < noise_rise.end_ms + 5000) {
+      noise_rise_anomalies++;
+      continue;
+    }
+    for (int i = 0; i < NUM_FAULTS; i++) {
+      if (now >= faults[i].start_ms && now < faults[i].end_ms + 5000) {
+        if (detection_ms[i] == 0) detection_ms[i] = now;
+        last_anomaly_ms[i] = now;
+        attributed = true;
+      }
+    }
+    if (!attributed) false_alarms++;
+  }
+
+  float operational_s = (millis() - operational_start_ms) / 1000.0f;
+
+  printf("Mode: %s sampling | Simulated: %.0f s\n",
+         adaptive ? "adaptive" : "fixed", millis() / 1000.0f);
+  printf("Active samples: %u total | %.1f per operational second\n",
+         sample_rate.active_samples, operational_samples / fmax(operational_s, 1.0f));
+  for (int i = 0; i < NUM_FAULTS; i++) {
+    if (faults[i].start_ms >= duration_ms) continue;
+    if (detection_ms[i]) {
+      printf("Fault '%s': detected after %u ms, settled %d ms after its end\n", faults[i].name,
+             detection_ms[i] - faults[i].start_ms,
+             (int)(last_anomaly_ms[i] - faults[i].end_ms));
+    } else {
+      printf("Fault '%s': MISSED\n", faults[i].name);
+    }
+  }
+  printf("False alarms: %u of %u predictions\n", false_alarms, metrics.total_predictions);
+  for (int i = 0; i < NUM_INPUT_FAULTS; i++) {
+    if (input_faults[i].start_ms >= duration_ms) continue;
+    if (input_detection_ms[i]) {
+      printf("Input fault '%s': SENSOR_FAULT after %u ms\n", input_faults[i].name,
+             input_detection_ms[i] - input_faults[i].start_ms);
+    } else {
+      printf("Input fault '%s': MISSED\n", input_faults[i].name);
+    }
+  }
+  printf("Loop stall: %u gaps | %u samples missed\n", metrics.sample_gaps, metrics.samples_missed);
+  printf("Sensor health flagged on %u decisions (noise floor %.2f mV, learned %.2f mV)\n",
+         metrics.sensor_degraded, noise_monitor.noiseRms() * 1000,
+         noise_monitor.learnedNoiseRms() * 1000);
+  if (noise_rise.start_ms < duration_ms) {
+    if (noise_rise_ms) {
+      printf("Sensor degradation '%s': NOISE_FLOOR_RISE after %u ms | %u process anomalies in it\n",
+             noise_rise.name, noise_rise_ms - noise_rise.start_ms, noise_rise_anomalies);
+    } else {
+      printf("Sensor degradation '%s': MISSED | %u process anomalies in it\n",
+             noise_rise.name, noise_rise_anomalies);
+    }
+  }
+  printf("Sensor health flagged in process faults: %u decisions (%s)\n",
+         flagged_in_faults, flagged_in_faults ? "FAIL" : "PASS");
+
+  Serial.echo = true;
+  shadow_detectors.printSummary();
+  return 0;
+}
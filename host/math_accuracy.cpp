@@ -0,0 +1,88 @@
+/*
+ * FAST MATH ACCURACY CHECK (LINUX)
+ * ESP32 Anomaly Detection System
+ *
+ * Checks the sketch's fast-math kernels against libm (in double) and
+ * exits non-zero if any documented bound is exceeded:
+ * - Every mantissa table cell of every exponent from 2^-40 to 2^40,
+ *   sampled at its ends and 64 points inside
+ * - 10^6 log-uniform random inputs over the same span
+ * Then prints the same exact-vs-fast timing as the "mathbench" serial
+ * command, for comparison with the numbers a board reports.
+ *
+ * Compile: g++ -std=gnu++17 -O2 -I host host/math_accuracy.cpp -o math_accuracy
+ * Usage:   ./math_accuracy
+ */
+
+#include "../esp32_anomaly_main.cpp"
+
+struct Check {
+  const char* name;
+  double bound;
+  bool relative;
+  double worst;
+  float worst_x;
+};
+
+static Check checks[] = {
+  {"rsqrt", 5e-6,   true,  0, 0},
+  {"sqrt",  5e-6,   true,  0, 0},
+  {"recip", 7e-5,   true,  0, 0},
+  {"log2",  5e-5,   false, 0, 0},
+  {"log10", 1.5e-5, false, 0, 0},
+};
+static const int NUM_CHECKS = sizeof(checks) / sizeof(checks[0]);
+
+static void record(Check& c, float x, double got, double want) {
+  double err = fabs(got - want);
+  if (c.relative) err /= fabs(want);
+  if (err > c.worst) {
+    c.worst = err;
+    c.worst_x = x;
+  }
+}
+
+static void checkInput(float x) {
+  double xd = x;
+  record(checks[0], x, fastRsqrt(x), 1.0 / sqrt(xd));
+  record(checks[1], x, mathSqrt(x, true), sqrt(xd));
+  record(checks[2], x, fastRecip(x), 1.0 / xd);
+  record(checks[3], x, fastLog2(x), log2(xd));
+  record(checks[4], x, mathLog10(x, true), log10(xd));
+}
+
+int main() {
+  uint64_t inputs = 0;
+  for (int e = -40; e < 40; e++) {
+    for (int cell = 0; cell < MATH_TABLE_SIZE; cell++) {
+      for (int k = 0; k <= 64; k++) {
+        double m = 1.0 + (cell + k / 64.0) / MATH_TABLE_SIZE;
+        float x = (float)ldexp(fmin(m, 1.99999988), e);
+        checkInput(x);
+        inputs++;
+      }
+    }
+  }
+  uint32_t state = 1;
+  for (int i = 0; i < 1000000; i++) {
+    state = state * 1664525u + 1013904223u;
+    checkInput((float)exp2(-40.0 + 80.0 * (state >> 8) / 16777216.0));
+    inputs++;
+  }
+
+  bool ok = (mathSqrt(0.0f, true) == 0.0f);
+  printf("Checked %llu inputs in [2^-40, 2^40); sqrt(0) = %g\n\n",
+         (unsigned long long)inputs, mathSqrt(0.0f, true));
+  printf("%-6s %-9s %-12s %-12s %s\n", "Kernel", "Error", "Worst", "Bound", "At x");
+  for (int i = 0; i < NUM_CHECKS; i++) {
+    const Check& c = checks[i];
+    bool pass = c.worst < c.bound;
+    ok = ok && pass;
+    printf("%-6s %-9s %-12.3e %-12.3e %-12.6g %s\n", c.name, c.relative ? "relative" : "absolute",
+           c.worst, c.bound, c.worst_x, pass ? "PASS" : "FAIL");
+  }
+  printf("\n");
+
+  printMathBenchmark();
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,331 @@
+/*
+ * MATRIX PROFILE DISCORD MINING (LINUX)
+ * ESP32 Anomaly Detection System
+ *
+ * Offline reference for what the on-device detector misses. Computes the
+ * z-normalized matrix profile of a recorded ADC stream and reports the
+ * top-k discords: the subsequences whose nearest non-trivial neighbour is
+ * farthest away, i.e. the most unusual shapes in the recording.
+ *
+ * - SCRIMP-style diagonal traversal with incremental dot products:
+ *   QT(i+1, j+1) = QT(i, j) - x[i]x[j] + x[i+m]x[j+m], so every pair costs
+ *   O(1) after the first dot product of its diagonal
+ * - 8 adjacent diagonals advance together, which the compiler turns into
+ *   SIMD lanes (build with -O3 -march=native)
+ * - Diagonal blocks are shuffled and shared by worker threads; -f < 1
+ *   stops after that fraction of them (anytime mode: the profile is then
+ *   an upper bound and the strongest discords usually already stand out)
+ *
+ * Exact work is ~n^2/2 pair updates at roughly 4e8 per second per core:
+ * a day at 100 Hz (8.6 M samples) is ~3.7e13 updates, about an hour and
+ * a half on 16 cores. Use -f 0.05..0.2 for a first pass in minutes.
+ *
+ * Input: one sample per line, either "ms,value[,...]" (the snapshot
+ * format) or a bare value taken every SAMPLE_PERIOD_MS. Other lines are
+ * skipped, as are repeated or out-of-order timestamps, so overlapping
+ * snapshot dumps can be concatenated. With -l, each discord is checked
+ * against the "[<ms> ms] Status: ANOMALY" lines of the detector's serial
+ * log from the same run; only every 10th decision is printed, so keep
+ * the tolerance (-w) at a second or more.
+ *
+ * Compile: g++ -std=gnu++17 -O3 -march=native -pthread -I host host/matrix_profile.cpp -o matrix_profile
+ * Usage:   ./matrix_profile capture.csv [-m length] [-k discords] [-t threads]
+ *                           [-f fraction] [-l decisions.log] [-w tolerance_ms]
+ */
+
+#include "../esp32_anomaly_main.cpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+#define MP_LANES 8  // diagonals advanced together
+
+struct Recording {
+  std::vector<double> t_ms;
+  std::vector<double> x;
+};
+
+static bool loadRecording(const char* path, Recording& rec) {
+  FILE* in = fopen(path, "r");
+  if (!in) {
+    perror(path);
+    return false;
+  }
+  char line[256];
+  double last_ms = -1;
+  while (fgets(line, sizeof(line), in)) {
+    double ms, value;
+    if (sscanf(line, "%lf,%lf", &ms, &value) == 2) {
+      if (ms <= last_ms) continue;  // overlapping snapshot dumps
+      last_ms = ms;
+    } else if (sscanf(line, "%lf", &value) == 1 && strchr(line, ',') == NULL) {
+      ms = rec.x.size() * (double)SAMPLE_PERIOD_MS;
+    } else {
+      continue;
+    }
+    rec.t_ms.push_back(ms);
+    rec.x.push_back(value);
+  }
+  fclose(in);
+  return true;
+}
+
+static std::vector<uint32_t> loadAnomalyTimes(const char* path) {
+  std::vector<uint32_t> times;
+  FILE* in = fopen(path, "r");
+  if (!in) {
+    perror(path);
+    return times;
+  }
+  char line[512];
+  while (fgets(line, sizeof(line), in)) {
+    unsigned ms;
+    const char* stamp = strchr(line, '[');
+    if (stamp && sscanf(stamp, "[%u ms]", &ms) == 1 && strstr(line, "Status: ANOMALY")) {
+      times.push_back(ms);
+    }
+  }
+  fclose(in);
+  return times;
+}
+
+// ============================================================================
+// MATRIX PROFILE
+// ============================================================================
+
+class MatrixProfile {
+private:
+  std::vector<double> x;    // centred by the global mean to limit cancellation
+  int m;
+  int64_t n_sub;
+  int exclusion;
+  std::vector<double> mu;
+  std::vector<double> inv;  // 1 / (sqrt(m) * sigma), 0 for flat subsequences
+
+  void computeStatistics() {
+    double centre = 0;
+    for (double v : x) centre += v;
+    centre /= x.size();
+    for (double& v : x) v -= centre;
+
+    double sum = 0, sum_sq = 0;
+    for (int i = 0; i < m; i++) {
+      sum += x[i];
+      sum_sq += x[i] * x[i];
+    }
+    for (int64_t i = 0; i < n_sub; i++) {
+      if (i > 0) {
+        sum += x[i + m - 1] - x[i - 1];
+        sum_sq += x[i + m - 1] * x[i + m - 1] - x[i - 1] * x[i - 1];
+      }
+      double mean = sum / m;
+      double var = sum_sq / m - mean * mean;
+      mu[i] = mean;
+      inv[i] = (var > 1e-12) ? 1.0 / sqrt(m * var) : 0.0;
+    }
+  }
+
+  void processBlock(int64_t k0, float* profile) const {
+    // Diagonals k0 .. k0+MP_LANES-1: pairs (i, i + k0 + lane)
+    double qt[MP_LANES];
+    int lanes = 0;
+    for (int l = 0; l < MP_LANES && k0 + l < n_sub; l++, lanes++) {
+      double dot = 0;
+      for (int t = 0; t < m; t++) dot += x[t] * x[k0 + l + t];
+      qt[l] = dot;
+    }
+
+    // Common part: every lane in range, branch-free for vectorization. It
+    // stops one row early: the last lane's final row has no next x[j + m]
+    // to advance into, and the tail takes that row without advancing
+    int64_t common = n_sub - (k0 + lanes);
+    if (lanes < MP_LANES) common = 0;
+    for (int64_t i = 0; i < common; i++) {
+      const double* xj = &x[i + k0];
+      const double* xjm = &x[i + k0 + m];
+      const double* muj = &mu[i + k0];
+      const double* invj = &inv[i + k0];
+      float* pj = &profile[i + k0];
+      double mu_i = mu[i] * m, inv_i = inv[i];
+      double xi = x[i], xim = x[i + m];
+      float row = -2;
+
+#pragma GCC ivdep
+      for (int l = 0; l < MP_LANES; l++) {
+        float corr = (float)((qt[l] - mu_i * muj[l]) * inv_i * invj[l]);
+        row = (corr > row) ? corr : row;
+        pj[l] = (corr > pj[l]) ? corr : pj[l];
+        qt[l] += xim * xjm[l] - xi * xj[l];
+      }
+      if (row > profile[i]) profile[i] = row;
+    }
+
+    // Ragged tail: lanes run out one by one at the end of the series
+    for (int l = 0; l < lanes; l++) {
+      double q = qt[l];
+      for (int64_t i = common; i + k0 + l < n_sub; i++) {
+        int64_t j = i + k0 + l;
+        float corr = (float)((q - m * mu[i] * mu[j]) * inv[i] * inv[j]);
+        if (corr > profile[i]) profile[i] = corr;
+        if (corr > profile[j]) profile[j] = corr;
+        if (j + 1 < n_sub) q += x[i + m] * x[j + m] - x[i] * x[j];
+      }
+    }
+  }
+
+public:
+  std::vector<float> correlation;  // best correlation per subsequence
+  uint64_t pairs = 0;
+
+  MatrixProfile(const std::vector<double>& series, int length)
+    : x(series), m(length), n_sub((int64_t)series.size() - length + 1),
+      exclusion((length + 3) / 4), mu(n_sub), inv(n_sub) {}
+
+  int64_t subsequences() const { return n_sub; }
+
+  void compute(int threads, double fraction) {
+    computeStatistics();
+
+    std::vector<int64_t> blocks;
+    for (int64_t k = exclusion; k < n_sub; k += MP_LANES) blocks.push_back(k);
+    std::mt19937_64 rng(12345);
+    std::shuffle(blocks.begin(), blocks.end(), rng);
+    size_t budget = (size_t)ceil(blocks.size() * fraction);
+    if (budget > blocks.size()) budget = blocks.size();
+
+    std::vector<std::vector<float>> partial(threads, std::vector<float>(n_sub, -2.0f));
+    std::atomic<size_t> next(0);
+    std::atomic<uint64_t> total_pairs(0);
+    std::vector<std::thread> workers;
+    for (int w = 0; w < threads; w++) {
+      workers.emplace_back([&, w]() {
+        uint64_t done = 0;
+        for (size_t b; (b = next.fetch_add(1)) < budget;) {
+          int64_t k0 = blocks[b];
+          processBlock(k0, partial[w].data());
+          for (int l = 0; l < MP_LANES && k0 + l < n_sub; l++) done += n_sub - (k0 + l);
+        }
+        total_pairs += done;
+      });
+    }
+    for (std::thread& t : workers) t.join();
+
+    correlation.assign(n_sub, -2.0f);
+    for (int w = 0; w < threads; w++) {
+      for (int64_t i = 0; i < n_sub; i++) {
+        if (partial[w][i] > correlation[i]) correlation[i] = partial[w][i];
+      }
+    }
+    pairs = total_pairs;
+  }
+
+  float distance(int64_t i) const {
+    // z-normalized Euclidean distance from the best correlation
+    float c = correlation[i];
+    if (c < -1.5f) return -1;  // never compared (anytime mode)
+    return sqrt(fmax(2.0 * m * (1.0 - c), 0.0));
+  }
+
+  std::vector<int64_t> discords(int k) const {
+    std::vector<int64_t> order(n_sub);
+    for (int64_t i = 0; i < n_sub; i++) order[i] = i;
+    std::sort(order.begin(), order.end(),
+              [&](int64_t a, int64_t b) { return distance(a) > distance(b); });
+
+    std::vector<int64_t> picked;
+    for (int64_t i : order) {
+      if ((int)picked.size() == k || distance(i) < 0) break;
+      bool overlaps = false;
+      for (int64_t p : picked) {
+        if (llabs(p - i) < m) overlaps = true;
+      }
+      if (!overlaps) picked.push_back(i);
+    }
+    return picked;
+  }
+};
+
+// ============================================================================
+// DRIVER
+// ============================================================================
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s capture.csv [-m length] [-k discords] [-t threads] "
+                    "[-f fraction] [-l decisions.log] [-w tolerance_ms]\n", argv[0]);
+    return 1;
+  }
+
+  int m = FEATURE_WINDOW * 2;
+  int k = 10;
+  int threads = (int)std::thread::hardware_concurrency();
+  double fraction = 1.0;
+  const char* log_path = NULL;
+  double tolerance_ms = 1000;
+  for (int i = 2; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "-m") == 0) m = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "-k") == 0) k = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "-t") == 0) threads = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "-f") == 0) fraction = atof(argv[i + 1]);
+    else if (strcmp(argv[i], "-l") == 0) log_path = argv[i + 1];
+    else if (strcmp(argv[i], "-w") == 0) tolerance_ms = atof(argv[i + 1]);
+  }
+  if (threads < 1) threads = 1;
+
+  Recording rec;
+  if (!loadRecording(argv[1], rec)) return 1;
+  if ((int64_t)rec.x.size() < 4 * (int64_t)m) {
+    fprintf(stderr, "%s: %zu samples, need at least %d for m=%d\n",
+            argv[1], rec.x.size(), 4 * m, m);
+    return 1;
+  }
+
+  printf("Samples: %zu (%.1f s) | m = %d | threads = %d | fraction = %.3f\n",
+         rec.x.size(), (rec.t_ms.back() - rec.t_ms.front()) / 1000.0, m, threads, fraction);
+
+  MatrixProfile profile(rec.x, m);
+  auto start = std::chrono::steady_clock::now();
+  profile.compute(threads, fraction);
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  printf("Matrix profile: %.3g pair updates in %.1f s (%.3g per second)\n\n",
+         (double)profile.pairs, seconds, profile.pairs / fmax(seconds, 1e-9));
+
+  std::vector<uint32_t> anomalies;
+  if (log_path) anomalies = loadAnomalyTimes(log_path);
+
+  std::vector<int64_t> top = profile.discords(k);
+  int flagged = 0;
+  printf("Rank  Start ms      End ms        Distance  Detector\n");
+  for (size_t r = 0; r < top.size(); r++) {
+    int64_t i = top[r];
+    double start_ms = rec.t_ms[i], end_ms = rec.t_ms[i + m - 1];
+    printf("%-5zu %-13.0f %-13.0f %-9.3f ", r + 1, start_ms, end_ms, profile.distance(i));
+
+    if (!log_path) {
+      printf("-\n");
+      continue;
+    }
+    const uint32_t* hit = NULL;
+    for (const uint32_t& t : anomalies) {
+      if (t >= start_ms - tolerance_ms && t <= end_ms + tolerance_ms) {
+        hit = &t;
+        break;
+      }
+    }
+    if (hit) {
+      printf("ANOMALY at %u ms\n", *hit);
+      flagged++;
+    } else {
+      printf("MISSED\n");
+    }
+  }
+  if (log_path) {
+    printf("\n%d of %zu discords flagged by the detector (%zu ANOMALY lines, +/-%.0f ms)\n",
+           flagged, top.size(), anomalies.size(), tolerance_ms);
+  }
+  return 0;
+}
@@ -0,0 +1,63 @@
+/*
+ * PSEUDO-TERMINAL DEVICE STAND-IN (LINUX)
+ * ESP32 Anomaly Detection System
+ *
+ * Runs the sketch in real time on a synthetic sensor with its Serial port
+ * attached to a pseudo-terminal, so host tools can drive the runtime
+ * command interface exactly as they would a board on /dev/ttyUSB0:
+ *
+ *   ./serial_pty_device [speedup]      prints e.g. "PTY: /dev/pts/7"
+ *   screen /dev/pts/7                  or any serial script
+ *   set filter_alpha 0.3
+ *
+ * speedup > 1 runs the simulated clock faster than real time.
+ *
+ * Compile: g++ -std=gnu++17 -O2 -I host host/serial_pty_device.cpp -o serial_pty_device
+ */
+
+#include "../esp32_anomaly_main.cpp"
+
+#include <fcntl.h>
+#include <termios.h>
+
+static uint32_t noise_state = 1;
+
+static int syntheticSensor(int) {
+  noise_state = noise_state * 1664525u + 1013904223u;
+  float noise = ((noise_state >> 8) * (1.0f / 8388608.0f)) - 1.0f;
+  return (int)(2000 + 15 * sin(millis() * 0.0005f) + 4 * noise);
+}
+
+int main(int argc, char** argv) {
+  float speedup = (argc > 1) ? atof(argv[1]) : 1.0f;
+
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+    perror("posix_openpt");
+    return 1;
+  }
+
+  // Raw mode on the device end, like a UART: no echo, no line editing
+  const char* slave_name = ptsname(master);
+  int slave = open(slave_name, O_RDWR | O_NOCTTY);
+  struct termios tio;
+  tcgetattr(slave, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(slave, TCSANOW, &tio);
+
+  // Never block the sketch when nobody is reading the terminal
+  fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+  printf("PTY: %s\n", slave_name);
+  fflush(stdout);
+
+  sim_analog_source = syntheticSensor;
+  Serial.fd = master;
+
+  setup();
+  for (;;) {
+    uint64_t before_us = sim_time_us;
+    loop();
+    usleep((useconds_t)((sim_time_us - before_us) / speedup));
+  }
+}
@@ -0,0 +1,610 @@
+/*
+ * TELEMETRY AGGREGATOR (LINUX)
+ * ESP32 Anomaly Detection System
+ *
+ * Reads the serial output of many devices at once and serves fleet-wide
+ * counters and histograms in Prometheus text format on a localhost port:
+ * - Sources: serial ports / ptys / FIFOs (watched with epoll), regular
+ *   files (replayed once) and device connections to a Unix socket (-u),
+ *   the local stand-in for a serial gateway; one device per stream
+ * - Records: printDecision() lines (status, score, reason, sensor flags),
+ *   SENSOR_FAULT lines, learning progress, and the DETAILED DIAGNOSTICS
+ *   block, whose cumulative device totals are turned into deltas
+ * - Parsing is in place in a fixed per-stream line buffer (no allocation
+ *   per line); lines over STREAM_LINE_MAX are counted and dropped
+ * - Each worker thread owns its streams and a cache-line aligned shard of
+ *   counters and histograms; only the owner writes it (relaxed atomics,
+ *   no locked read-modify-write) and a scrape sums the shards
+ *
+ * Decision lines are printed for every 10th decision only, so the decision,
+ * reason and score series are a 1-in-10 sample; the diagnostics totals
+ * (verbosity 2) are exact.
+ *
+ * -g N replaces the inputs with N synthetic devices on socket pairs, fed
+ * as fast as the workers drain them for -s seconds, and reports the parse
+ * rate per worker CPU second and the device count one core sustains.
+ *
+ * Compile: g++ -std=gnu++17 -O2 -pthread -I host host/telemetry_aggregator.cpp -o telemetry_aggregator
+ * Usage:   ./telemetry_aggregator [-p port] [-t threads] [-u socket] [source ...]
+ *          ./telemetry_aggregator -g devices [-s seconds] [-t threads]
+ *          curl http://127.0.0.1:9464/metrics
+ */
+
+#include "../esp32_anomaly_main.cpp"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#define STREAM_LINE_MAX 512            // Longest device line kept (printDecision is ~150)
+#define DEFAULT_METRICS_PORT 9464
+#define NUM_FAULT_KINDS (FAULT_FLOATING + 1)
+
+// ============================================================================
+// SHARDED METRICS
+// ============================================================================
+
+enum Counter {
+  C_LINES, C_BYTES, C_MALFORMED, C_OVERLONG, C_STREAMS_CLOSED,
+  C_DECISIONS_NORMAL, C_DECISIONS_ANOMALY, C_SENSOR_FLAGGED, C_LEARNING_LINES,
+  C_LEARNING_DONE, C_FAULT_CLEARED, C_BOOTS,
+  C_PREDICTIONS, C_DETECTIONS, C_SAMPLES_MISSED, C_FAULT_ONSETS, C_GATE_SKIPPED,
+  NUM_COUNTERS
+};
+
+// Device totals printed cumulatively by dumpDiagnostics()
+enum DeviceTotal { T_PREDICTIONS, T_DETECTIONS, T_SAMPLES_MISSED, T_FAULT_ONSETS, T_GATE_SKIPPED,
+                   NUM_TOTALS };
+static const Counter total_counter[NUM_TOTALS] = {
+  C_PREDICTIONS, C_DETECTIONS, C_SAMPLES_MISSED, C_FAULT_ONSETS, C_GATE_SKIPPED,
+};
+
+struct CounterInfo {
+  const char* name;
+  const char* labels;      // fixed label set, or "" for none
+  const char* help;
+};
+
+static const CounterInfo counter_info[NUM_COUNTERS] = {
+  {"telemetry_lines_total", "", "Device lines read"},
+  {"telemetry_bytes_total", "", "Device bytes read"},
+  {"telemetry_malformed_lines_total", "", "Recognized records that failed to parse"},
+  {"telemetry_overlong_lines_total", "", "Lines dropped for exceeding the line buffer"},
+  {"telemetry_streams_closed_total", "", "Device streams ended"},
+  {"anomaly_decision_lines_total", "{status=\"normal\"}", "Printed decisions (1 in 10)"},
+  {"anomaly_decision_lines_total", "{status=\"anomaly\"}", NULL},
+  {"anomaly_sensor_flagged_lines_total", "", "Printed decisions with a sensor health flag"},
+  {"anomaly_learning_lines_total", "", "Printed learning-phase progress lines"},
+  {"anomaly_learning_completed_total", "", "Learning phases completed"},
+  {"anomaly_sensor_fault_cleared_total", "", "SENSOR_FAULT recoveries"},
+  {"anomaly_device_boots_total", "", "Device boot banners seen"},
+  {"anomaly_predictions_total", "", "Device predictions (diagnostics totals)"},
+  {"anomaly_detections_total", "", "Device anomaly decisions (diagnostics totals)"},
+  {"anomaly_samples_missed_total", "", "ADC samples missed by devices"},
+  {"anomaly_sensor_fault_onsets_total", "", "Sensor fault onsets on devices"},
+  {"anomaly_gate_skipped_total", "", "Decisions reused by the change gate"},
+};
+
+static inline void bump(std::atomic<uint64_t>& counter, uint64_t n = 1) {
+  // Single writer per shard: a plain load/store pair, never a locked RMW
+  counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+struct ShardHistogram {
+  std::atomic<uint64_t> buckets[LogLinearHistogram::NUM_BUCKETS] = {};
+  std::atomic<uint64_t> sum_micro{0};  // sum of observations x 1e6
+
+  void record(float value) {
+    if (!(value >= 0)) return;  // log-linear buckets hold magnitudes only
+    bump(buckets[LogLinearHistogram::bucketIndex(value)]);
+    bump(sum_micro, (uint64_t)(value * 1e6f + 0.5f));
+  }
+};
+
+struct alignas(64) Shard {
+  std::atomic<uint64_t> counters[NUM_COUNTERS] = {};
+  std::atomic<uint64_t> reasons[NUM_JOURNAL_REASONS] = {};  // index 0: unknown
+  std::atomic<uint64_t> faults[NUM_FAULT_KINDS] = {};
+  ShardHistogram score;
+  ShardHistogram noise_mv;
+  ShardHistogram snr_db;
+};
+
+// ============================================================================
+// IN-PLACE LINE PARSING
+// ============================================================================
+
+struct Stream {
+  int fd;
+  uint16_t used = 0;
+  bool overlong = false;
+  uint32_t last_total[NUM_TOTALS] = {0};
+  char buffer[STREAM_LINE_MAX];
+};
+
+struct Cursor {
+  const char* p;
+
+  bool lit(const char* text) {
+    size_t n = strlen(text);
+    if (strncmp(p, text, n) != 0) return false;
+    p += n;
+    return true;
+  }
+  bool seek(const char* text) {
+    const char* at = strstr(p, text);
+    if (at) p = at + strlen(text);
+    return at != NULL;
+  }
+  bool u32(uint32_t& value) {
+    char* end;
+    unsigned long v = strtoul(p, &end, 10);
+    if (end == p) return false;
+    value = (uint32_t)v;
+    p = end;
+    return true;
+  }
+  bool f32(float& value) {
+    char* end;
+    value = strtof(p, &end);
+    if (end == p) return false;
+    p = end;
+    return true;
+  }
+  size_t token() const { return strcspn(p, " |"); }
+};
+
+static void addTotal(Stream& s, Shard& shard, DeviceTotal t, uint32_t value) {
+  // Cumulative device counter to delta; a smaller value means a restart
+  uint32_t delta = (value >= s.last_total[t]) ? value - s.last_total[t] : value;
+  s.last_total[t] = value;
+  if (delta) bump(shard.counters[total_counter[t]], delta);
+}
+
+static int reasonIndex(const Cursor& c) {
+  size_t n = c.token();
+  for (int i = 1; i < NUM_JOURNAL_REASONS; i++) {
+    if (strlen(journal_reasons[i]) == n && strncmp(c.p, journal_reasons[i], n) == 0) return i;
+  }
+  return 0;
+}
+
+static int faultIndex(const Cursor& c) {
+  size_t n = c.token();
+  for (int i = 1; i < NUM_FAULT_KINDS; i++) {
+    const char* name = SensorFaultDetector::name((SensorFault_t)i);
+    if (strlen(name) == n && strncmp(c.p, name, n) == 0) return i;
+  }
+  return 0;
+}
+
+static bool parseDecision(Cursor& c, Shard& shard) {
+  // Status: <NORMAL|ANOMALY> | Score: s | Threshold: t | Confidence: c% | Reason: r [| r2] [| Sensor: ...]
+  if (c.lit("SENSOR_FAULT | Reason: ")) {
+    bump(shard.faults[faultIndex(c)]);
+    return true;
+  }
+  bool anomaly = c.lit("ANOMALY");
+  if (!anomaly && !c.lit("NORMAL")) return false;
+  float score;
+  if (!c.seek("Score: ") || !c.f32(score) || !c.seek("Reason: ")) return false;
+  bump(shard.counters[anomaly ? C_DECISIONS_ANOMALY : C_DECISIONS_NORMAL]);
+  bump(shard.reasons[reasonIndex(c)]);
+  shard.score.record(score);
+  if (c.seek("| Sensor: ")) bump(shard.counters[C_SENSOR_FLAGGED]);
+  return true;
+}
+
+static void parseLine(Stream& s, Shard& shard, char* line) {
+  Cursor c = {line};
+  uint32_t a, b;
+  float x;
+  bool ok = true;
+
+  bump(shard.counters[C_LINES]);
+  if (c.lit("[") && c.u32(a) && c.lit(" ms] ")) {
+    if (c.lit("Status: ")) ok = parseDecision(c, shard);
+    else if (c.lit("LEARNING: ")) bump(shard.counters[C_LEARNING_LINES]);
+    else if (c.lit("SENSOR_FAULT cleared")) bump(shard.counters[C_FAULT_CLEARED]);
+  } else if (c.lit("Detection Rate: ")) {
+    ok = c.seek("(") && c.u32(a) && c.lit("/") && c.u32(b);
+    if (ok) {
+      addTotal(s, shard, T_DETECTIONS, a);
+      addTotal(s, shard, T_PREDICTIONS, b);
+    }
+  } else if (c.lit("Noise Floor: ")) {
+    ok = c.f32(x);
+    if (ok) shard.noise_mv.record(x);
+    if (ok && c.seek("SNR: ") && c.f32(x)) shard.snr_db.record(x);
+  } else if (c.lit("Sample Gaps: ")) {
+    ok = c.u32(a) && c.seek("Missed: ") && c.u32(b);
+    if (ok) addTotal(s, shard, T_SAMPLES_MISSED, b);
+  } else if (c.lit("Sensor Faults: ")) {
+    ok = c.u32(a);
+    if (ok) addTotal(s, shard, T_FAULT_ONSETS, a);
+  } else if (c.lit("Change Gate: ")) {
+    ok = c.u32(a);
+    if (ok) addTotal(s, shard, T_GATE_SKIPPED, a);
+  } else if (strstr(line, "LEARNING PHASE COMPLETED")) {
+    bump(shard.counters[C_LEARNING_DONE]);
+  } else if (strstr(line, "INTELLIGENT ANOMALY DETECTION SYSTEM")) {
+    bump(shard.counters[C_BOOTS]);
+    memset(s.last_total, 0, sizeof(s.last_total));
+  }
+  if (!ok) bump(shard.counters[C_MALFORMED]);
+}
+
+static bool drain(Stream& s, Shard& shard) {
+  // Parse every complete line available; false once the stream has ended
+  for (;;) {
+    ssize_t n = read(s.fd, s.buffer + s.used, STREAM_LINE_MAX - 1 - s.used);
+    if (n == 0) return false;
+    if (n < 0) return errno == EAGAIN || errno == EINTR;
+    bump(shard.counters[C_BYTES], n);
+
+    char* start = s.buffer;
+    char* end = s.buffer + s.used + n;
+    for (char* nl; (nl = (char*)memchr(start, '\n', end - start)) != NULL; start = nl + 1) {
+      *nl = '\0';
+      if (nl > start && nl[-1] == '\r') nl[-1] = '\0';
+      if (s.overlong) s.overlong = false;  // tail of a dropped line
+      else parseLine(s, shard, start);
+    }
+    s.used = end - start;
+    memmove(s.buffer, start, s.used);
+    if (s.used == STREAM_LINE_MAX - 1) {
+      if (!s.overlong) bump(shard.counters[C_OVERLONG]);
+      s.overlong = true;
+      s.used = 0;
+    }
+  }
+}
+
+// ============================================================================
+// WORKERS
+// ============================================================================
+
+struct Worker {
+  int epoll_fd = -1;
+  Shard shard;
+  std::vector<int> files;  // regular files, replayed before watching streams
+  std::atomic<uint64_t> cpu_ns{0};
+
+  bool watch(int fd) {
+    // Safe from any thread: epoll_ctl hands the stream over to run()
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    Stream* s = new Stream();
+    s->fd = fd;
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.ptr = s;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+      perror("epoll_ctl");
+      close(fd);
+      delete s;
+      return false;
+    }
+    return true;
+  }
+
+  void run() {
+    for (int fd : files) {
+      Stream s;
+      s.fd = fd;
+      while (drain(s, shard)) {}
+      close(fd);
+      bump(shard.counters[C_STREAMS_CLOSED]);
+    }
+
+    epoll_event events[64];
+    for (;;) {
+      int n = epoll_wait(epoll_fd, events, 64, 1000);
+      for (int i = 0; i < n; i++) {
+        Stream* s = (Stream*)events[i].data.ptr;
+        if (!drain(*s, shard)) {
+          epoll_ctl(epoll_fd, EPOLL_CTL_DEL, s->fd, NULL);
+          close(s->fd);
+          delete s;
+          bump(shard.counters[C_STREAMS_CLOSED]);
+        }
+      }
+      timespec ts;
+      clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+      cpu_ns.store((uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec, std::memory_order_relaxed);
+    }
+  }
+};
+
+// Streams are attached by the main thread only, so it owns this counter
+static std::atomic<uint64_t> streams_opened{0};
+
+// ============================================================================
+// PROMETHEUS EXPOSITION
+// ============================================================================
+
+static uint64_t sumCounter(const std::vector<Worker*>& workers, int c) {
+  uint64_t total = 0;
+  for (const Worker* w : workers) total += w->shard.counters[c].load(std::memory_order_relaxed);
+  return total;
+}
+
+static void appendf(std::string& out, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+static void appendf(std::string& out, const char* fmt, ...) {
+  char line[256];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+  out += line;
+}
+
+static void renderHistogram(std::string& out, const std::vector<Worker*>& workers,
+                            ShardHistogram Shard::*member, const char* name, const char* help) {
+  appendf(out, "# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+  uint64_t cumulative = 0, sum_micro = 0;
+  for (const Worker* w : workers) sum_micro += (w->shard.*member).sum_micro.load(std::memory_order_relaxed);
+  for (int i = 0; i < LogLinearHistogram::NUM_BUCKETS; i++) {
+    for (const Worker* w : workers) {
+      cumulative += (w->shard.*member).buckets[i].load(std::memory_order_relaxed);
+    }
+    if (i + 1 < LogLinearHistogram::NUM_BUCKETS) {
+      appendf(out, "%s_bucket{le=\"%g\"} %llu\n", name, LogLinearHistogram::bucketLowerBound(i + 1),
+              (unsigned long long)cumulative);
+    }
+  }
+  appendf(out, "%s_bucket{le=\"+Inf\"} %llu\n", name, (unsigned long long)cumulative);
+  appendf(out, "%s_sum %.6f\n%s_count %llu\n", name, sum_micro * 1e-6, name,
+          (unsigned long long)cumulative);
+}
+
+static std::string renderMetrics(const std::vector<Worker*>& workers) {
+  std::string out;
+  out.reserve(32768);
+  for (int c = 0; c < NUM_COUNTERS; c++) {
+    const CounterInfo& info = counter_info[c];
+    uint64_t value = sumCounter(workers, c);
+    if (info.help) appendf(out, "# HELP %s %s\n# TYPE %s counter\n", info.name, info.help, info.name);
+    appendf(out, "%s%s %llu\n", info.name, info.labels, (unsigned long long)value);
+  }
+
+  appendf(out, "# HELP telemetry_streams_opened_total Device streams attached\n"
+               "# TYPE telemetry_streams_opened_total counter\n"
+               "telemetry_streams_opened_total %llu\n",
+          (unsigned long long)streams_opened.load(std::memory_order_relaxed));
+
+  appendf(out, "# HELP anomaly_reason_lines_total Printed decisions by primary reason (1 in 10)\n"
+               "# TYPE anomaly_reason_lines_total counter\n");
+  for (int r = 0; r < NUM_JOURNAL_REASONS; r++) {
+    uint64_t value = 0;
+    for (const Worker* w : workers) value += w->shard.reasons[r].load(std::memory_order_relaxed);
+    appendf(out, "anomaly_reason_lines_total{reason=\"%s\"} %llu\n",
+            r ? journal_reasons[r] : "OTHER", (unsigned long long)value);
+  }
+
+  appendf(out, "# HELP anomaly_sensor_fault_lines_total SENSOR_FAULT onsets printed by kind\n"
+               "# TYPE anomaly_sensor_fault_lines_total counter\n");
+  for (int f = 0; f < NUM_FAULT_KINDS; f++) {
+    uint64_t value = 0;
+    for (const Worker* w : workers) value += w->shard.faults[f].load(std::memory_order_relaxed);
+    appendf(out, "anomaly_sensor_fault_lines_total{fault=\"%s\"} %llu\n",
+            f ? SensorFaultDetector::name((SensorFault_t)f) : "OTHER", (unsigned long long)value);
+  }
+
+  renderHistogram(out, workers, &Shard::score, "anomaly_score",
+                  "Anomaly score of printed decisions (1 in 10)");
+  renderHistogram(out, workers, &Shard::noise_mv, "anomaly_noise_floor_mv",
+                  "Device noise floor in mV (diagnostics)");
+  renderHistogram(out, workers, &Shard::snr_db, "anomaly_snr_db",
+                  "Device SNR in dB (diagnostics)");
+  return out;
+}
+
+static void serveScrape(int listen_fd, const std::vector<Worker*>& workers) {
+  int fd = accept(listen_fd, NULL, NULL);
+  if (fd < 0) return;
+  // Only the request line matters; any path gets the metrics
+  char request[1024];
+  pollfd pfd = {fd, POLLIN, 0};
+  if (poll(&pfd, 1, 200) > 0 && read(fd, request, sizeof(request)) > 0) {
+    std::string body = renderMetrics(workers);
+    char header[160];
+    int n = snprintf(header, sizeof(header),
+                     "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                     "Content-Length: %zu\r\nConnection: close\r\n\r\n", body.size());
+    if (write(fd, header, n) < 0 || write(fd, body.data(), body.size()) < 0) { /* scraper left */ }
+  }
+  close(fd);
+}
+
+static int listenTcp(int port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0) {
+    perror("metrics port");
+    return -1;
+  }
+  return fd;
+}
+
+static int listenUnix(const char* path) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+  unlink(path);
+  if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 1024) != 0) {
+    perror(path);
+    return -1;
+  }
+  return fd;
+}
+
+// ============================================================================
+// LOAD GENERATOR
+// ============================================================================
+
+static const char* const sample_reasons[] = {"NORMAL", "NORMAL", "NORMAL", "MEAN_SHIFT",
+                                             "HIGH_VARIANCE", "ENVELOPE_MODULATION"};
+
+static int formatDeviceLine(char* out, size_t size, uint32_t device, uint32_t seq) {
+  // What a verbosity-2 device prints: a decision line per 10 decisions,
+  // and a diagnostics block every 10 decision lines
+  uint32_t ms = 60000 + seq * 1000;
+  float score = 0.2f + 0.05f * ((device * 7 + seq * 13) % 16);
+  switch (seq % 14) {
+    case 10: return snprintf(out, size, "Detection Rate: %.1f%% (%u/%u predictions)\n",
+                             2.0, seq / 4, seq * 10);
+    case 11: return snprintf(out, size, "Noise Floor: %.2f mV (Learned: %.2f) | SNR: %.1f dB | "
+                             "Sensor: OK\n", 1.1 + (device % 5) * 0.1, 1.1, 42.0);
+    case 12: return snprintf(out, size, "Sample Gaps: %u | Missed: %u total, 0 in window "
+                             "(0 open gaps)\n", seq / 100, seq / 50);
+    case 13: return snprintf(out, size, "Change Gate: %u skipped | %u full evaluations\n",
+                             seq * 6, seq * 4);
+    default:
+      return snprintf(out, size, "[%u ms] Status: %s | Score: %.3f | Threshold: 0.612 | "
+                      "Confidence: %.1f%% | Reason: %s\n", ms, score > 0.6f ? "ANOMALY" : "NORMAL",
+                      score, 80.0, sample_reasons[seq % 6]);
+  }
+}
+
+static void generateLoad(const std::vector<int>& fds, std::atomic<bool>& stop) {
+  // Round-robin writes of one line per device; a full socket is skipped
+  // and a partly written line resumes where it stopped
+  std::vector<uint32_t> seq(fds.size(), 0);
+  std::vector<uint16_t> offset(fds.size(), 0);
+  char line[STREAM_LINE_MAX];
+  while (!stop.load(std::memory_order_relaxed)) {
+    for (size_t d = 0; d < fds.size(); d++) {
+      int n = formatDeviceLine(line, sizeof(line), d, seq[d]);
+      ssize_t written = write(fds[d], line + offset[d], n - offset[d]);
+      if (written <= 0) continue;
+      offset[d] += written;
+      if (offset[d] == n) {
+        offset[d] = 0;
+        seq[d]++;
+      }
+    }
+  }
+}
+
+// ============================================================================
+// DRIVER
+// ============================================================================
+
+int main(int argc, char** argv) {
+  int port = DEFAULT_METRICS_PORT;
+  int threads = (int)std::thread::hardware_concurrency();
+  int generated = 0;
+  float seconds = 5;
+  const char* unix_path = NULL;
+  std::vector<const char*> sources;
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 < argc && strcmp(argv[i], "-p") == 0) port = atoi(argv[++i]);
+    else if (i + 1 < argc && strcmp(argv[i], "-t") == 0) threads = atoi(argv[++i]);
+    else if (i + 1 < argc && strcmp(argv[i], "-u") == 0) unix_path = argv[++i];
+    else if (i + 1 < argc && strcmp(argv[i], "-g") == 0) generated = atoi(argv[++i]);
+    else if (i + 1 < argc && strcmp(argv[i], "-s") == 0) seconds = atof(argv[++i]);
+    else sources.push_back(argv[i]);
+  }
+  if (sources.empty() && !unix_path && generated == 0) {
+    fprintf(stderr, "usage: %s [-p port] [-t threads] [-u socket] [source ...]\n"
+                    "       %s -g devices [-s seconds] [-t threads]\n", argv[0], argv[0]);
+    return 1;
+  }
+  if (threads < 1) threads = 1;
+
+  // Thousands of streams need thousands of descriptors
+  rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+
+  std::vector<Worker*> workers;
+  for (int w = 0; w < threads; w++) {
+    workers.push_back(new Worker());
+    workers.back()->epoll_fd = epoll_create1(0);
+  }
+
+  int next_worker = 0;
+  for (const char* path : sources) {
+    int fd = open(path, O_RDONLY | O_NOCTTY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+      perror(path);
+      continue;
+    }
+    Worker* w = workers[next_worker++ % threads];
+    if (S_ISREG(st.st_mode)) w->files.push_back(fd);
+    else if (!w->watch(fd)) continue;
+    streams_opened++;
+  }
+
+  std::vector<int> generator_fds;
+  for (int d = 0; d < generated; d++) {
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+      perror("socketpair");
+      return 1;
+    }
+    fcntl(pair[0], F_SETFL, fcntl(pair[0], F_GETFL) | O_NONBLOCK);
+    generator_fds.push_back(pair[0]);
+    if (workers[next_worker++ % threads]->watch(pair[1])) streams_opened++;
+  }
+
+  std::vector<std::thread> running;
+  for (Worker* w : workers) running.emplace_back([w]() { w->run(); });
+
+  if (generated > 0) {
+    std::atomic<bool> stop(false);
+    std::thread generator(generateLoad, std::cref(generator_fds), std::ref(stop));
+    usleep((useconds_t)(seconds * 1e6));
+    stop = true;
+    generator.join();
+    usleep(200000);  // let the workers drain what was written
+
+    uint64_t lines = sumCounter(workers, C_LINES), cpu_ns = 0;
+    for (const Worker* w : workers) cpu_ns += w->cpu_ns.load(std::memory_order_relaxed);
+    double per_cpu_second = lines / fmax(cpu_ns * 1e-9, 1e-9);
+    // A verbosity-2 device prints ~1 decision line per second plus a
+    // 14-line diagnostics block every 10 s: 2.4 lines per second
+    printf("Devices: %d | threads: %d | lines: %llu in %.1f s | malformed: %llu\n", generated,
+           threads, (unsigned long long)lines, seconds,
+           (unsigned long long)sumCounter(workers, C_MALFORMED));
+    printf("Parse rate: %.3g lines per worker CPU second | ~%.0f verbosity-2 devices per core\n",
+           per_cpu_second, per_cpu_second / 2.4);
+    fflush(stdout);
+    _exit(0);  // workers never return
+  }
+
+  int http_fd = listenTcp(port);
+  int unix_fd = unix_path ? listenUnix(unix_path) : -1;
+  if (http_fd < 0 || (unix_path && unix_fd < 0)) return 1;
+  fprintf(stderr, "Serving http://127.0.0.1:%d/metrics | %zu sources | %d workers%s%s\n",
+          port, sources.size(), threads, unix_path ? " | devices on " : "",
+          unix_path ? unix_path : "");
+
+  for (;;) {
+    pollfd fds[2] = {{http_fd, POLLIN, 0}, {unix_fd, POLLIN, 0}};
+    if (poll(fds, unix_fd >= 0 ? 2 : 1, -1) <= 0) continue;
+    if (fds[0].revents & POLLIN) serveScrape(http_fd, workers);
+    if (unix_fd >= 0 && (fds[1].revents & POLLIN)) {
+      int fd = accept(unix_fd, NULL, NULL);
+      if (fd >= 0 && workers[next_worker++ % threads]->watch(fd)) streams_opened++;
+    }
+  }
+}
@@ -0,0 +1,158 @@
+/*
+ * TREND ESTIMATOR BENCHMARK (LINUX)
+ * ESP32 Anomaly Detection System
+ *
+ * Feeds synthetic ramps through the sketch's filter and window, and
+ * compares the trend estimators on the same windows:
+ * - lsq:       full least-squares regression (extractFeatures)
+ * - inc:       sliding least-squares accumulators (accumulatorFeatures)
+ * - theil-sen: the sampled Theil-Sen estimator (theilSenTrend)
+ * - exact-ts:  Theil-Sen over all pairs, O(n^2) reference
+ *
+ * Reports the RMS error against the true slope on clean noisy ramps, the
+ * largest trend a single ADC spike produces while it crosses the window
+ * (the RAPID_TREND reason fires above 3.0), and the time per call.
+ * The inc column is n/a while a spike keeps the accumulator envelope
+ * broken; the loop then falls back to extractFeatures.
+ *
+ * Compile: g++ -std=gnu++17 -O2 -I host host/trend_benchmark.cpp -o trend_benchmark
+ * Usage:   ./trend_benchmark [trials]
+ */
+
+#include "../esp32_anomaly_main.cpp"
+
+#include <algorithm>
+#include <vector>
+
+#define NUM_ESTIMATORS 4
+
+static const char* estimator_names[NUM_ESTIMATORS] = {"lsq", "inc", "theil-sen", "exact-ts"};
+
+static uint32_t noise_state = 777;
+
+static float noise() {
+  noise_state = noise_state * 1664525u + 1013904223u;
+  return ((noise_state >> 8) * (1.0f / 8388608.0f)) - 1.0f;
+}
+
+static float exactTheilSen(uint16_t window) {
+  std::vector<float> t, y, slopes;
+  int start_idx = (buffer_index - window + BUFFER_SIZE) % BUFFER_SIZE;
+  for (int i = 0; i < window; i++) {
+    const SensorReading_t& r = sensor_buffer[(start_idx + i) % BUFFER_SIZE];
+    if (!r.is_valid) continue;
+    t.push_back(r.timestamp * (1.0f / SAMPLE_PERIOD_MS));
+    y.push_back(r.filtered_value);
+  }
+  for (size_t i = 0; i < t.size(); i++) {
+    for (size_t j = i + 1; j < t.size(); j++) slopes.push_back((y[j] - y[i]) / (t[j] - t[i]));
+  }
+  if (slopes.empty()) return 0;
+  std::sort(slopes.begin(), slopes.end());
+  size_t h = slopes.size() / 2;
+  return (slopes.size() % 2) ? slopes[h] : (slopes[h - 1] + slopes[h]) * 0.5f;
+}
+
+static void resetWindow() {
+  flushSensorWindow();
+  buffer_index = 0;
+}
+
+static void pushCode(float code) {
+  float volts = code * (3.3 / 4095.0);
+  float filtered = sensor_filter.apply(volts);
+  delay(SAMPLE_PERIOD_MS);
+  pushSensorReading(volts, filtered, SAMPLE_PERIOD_MS, millis());
+}
+
+// All estimators on the current window; available[i] false when one declines
+static void estimate(float out[NUM_ESTIMATORS], bool available[NUM_ESTIMATORS]) {
+  Features_t acc;
+  available[1] = accumulatorFeatures(acc);
+  out[1] = available[1] ? acc.trend : 0;
+  out[0] = extractFeatures().trend;  // also resyncs the accumulators
+  out[2] = theilSenTrend(tunables.feature_window);
+  out[3] = exactTheilSen(tunables.feature_window);
+  available[0] = available[2] = available[3] = true;
+}
+
+int main(int argc, char** argv) {
+  int trials = (argc > 1) ? atoi(argv[1]) : 200;
+  Serial.echo = false;
+  uint16_t window = tunables.feature_window;
+  const float volts_per_code = 3.3 / 4095.0;
+
+  // Accuracy: noisy ramps, random slopes up to +/-2 codes per sample
+  double sq_error[NUM_ESTIMATORS] = {0};
+  int samples[NUM_ESTIMATORS] = {0};
+  for (int trial = 0; trial < trials; trial++) {
+    resetWindow();
+    float slope_codes = 2.0f * noise();
+    float true_slope = slope_codes * volts_per_code;
+    for (int i = 0; i < 3 * window; i++) {
+      pushCode(2000 + slope_codes * i + 4 * noise());
+      if (i < 2 * window) continue;
+      float out[NUM_ESTIMATORS];
+      bool available[NUM_ESTIMATORS];
+      estimate(out, available);
+      for (int e = 0; e < NUM_ESTIMATORS; e++) {
+        if (!available[e]) continue;
+        sq_error[e] += (out[e] - true_slope) * (out[e] - true_slope);
+        samples[e]++;
+      }
+    }
+  }
+
+  // Robustness: one spike of +800 codes crossing a flat noisy window
+  float worst[NUM_ESTIMATORS] = {0};
+  int declined[NUM_ESTIMATORS] = {0};
+  for (int trial = 0; trial < trials; trial++) {
+    resetWindow();
+    int spike_at = 2 * window;
+    for (int i = 0; i < spike_at + 2 * window; i++) {
+      pushCode(2000 + 4 * noise() + (i == spike_at ? 800 : 0));
+      if (i < spike_at) continue;
+      float out[NUM_ESTIMATORS];
+      bool available[NUM_ESTIMATORS];
+      estimate(out, available);
+      for (int e = 0; e < NUM_ESTIMATORS; e++) {
+        if (!available[e]) { declined[e]++; continue; }
+        worst[e] = fmax(worst[e], fabs(out[e]));
+      }
+    }
+  }
+
+  // Speed: repeated calls on one full window
+  resetWindow();
+  for (int i = 0; i < 2 * window; i++) pushCode(2000 + 0.5f * i + 4 * noise());
+  extractFeatures();
+  const int reps = 20000;
+  double us_per_call[NUM_ESTIMATORS];
+  volatile float sink = 0;
+  for (int e = 0; e < NUM_ESTIMATORS; e++) {
+    uint32_t start = micros();
+    for (int r = 0; r < reps; r++) {
+      Features_t f;
+      switch (e) {
+        case 0: sink = extractFeatures().trend; break;
+        case 1: accumulatorFeatures(f); sink = f.trend; break;
+        case 2: sink = theilSenTrend(window); break;
+        case 3: sink = exactTheilSen(window); break;
+      }
+    }
+    us_per_call[e] = (double)(micros() - start) / reps;
+  }
+  (void)sink;
+
+  printf("Window: %u samples | %d trials | trend in V per %d ms\n\n",
+         window, trials, SAMPLE_PERIOD_MS);
+  printf("%-10s %-14s %-18s %-10s\n", "Estimator", "RMS error", "Max |trend| spike", "us/call");
+  for (int e = 0; e < NUM_ESTIMATORS; e++) {
+    printf("%-10s %-14.3e %-18.4f %-10.2f", estimator_names[e],
+           sqrt(sq_error[e] / fmax(samples[e], 1)), worst[e], us_per_call[e]);
+    if (declined[e]) printf("  (n/a on %d spike windows)", declined[e]);
+    printf("\n");
+  }
+  printf("\nSlopes compare against %.3e V per period at 1 code per sample.\n", volts_per_code);
+  return 0;
+}
@@ -0,0 +1,441 @@
+/*
+ * SLIDING-WINDOW FEATURE KERNEL (LINUX)
+ * ESP32 Anomaly Detection System
+ *
+ * Offline counterpart of extractFeatures(): mean, std_dev, rms, min, max
+ * and trend for EVERY window position of a recording, not only the one
+ * the device scores every update_interval_ms.
+ *
+ * - The raw volts go through the sketch's own SensorFilter first, so the
+ *   windows see the same filtered_value series the device buffers
+ * - A block of window positions is split into 16 runs of consecutive
+ *   windows, one per SIMD lane, and transposed so that one step of all
+ *   lanes reads one contiguous vector
+ * - Every lane keeps double running sums (sum, sum of squares, sum of
+ *   x * value) and slides them by one sample per step: O(1) per window
+ *   instead of O(window), and no serial dependency longer than a run
+ * - Min/max use the van Herk / Gil-Werman scan: running extremes forward
+ *   and backward inside blocks of one window length, so every window is
+ *   the min/max of two precomputed values
+ * - All loops run across the lanes without branches, which the compiler
+ *   turns into SIMD (build with -O3 -march=native); blocks are shared by
+ *   worker threads
+ *
+ * About 2e8 windows per second per core at the default window of 50,
+ * some 100x the rate of extractFeatures() (-v reports both).
+ *
+ * Semantics are those of extractFeatures() on a full window of evenly
+ * spaced samples: least-squares trend in volts per nominal sample period
+ * (ENABLE_ROBUST_TREND replaces it with Theil-Sen on the device), std_dev
+ * and rms through mathSqrt(FAST_MATH_FEATURES). Timestamps are ignored;
+ * the samples are taken as one per SAMPLE_PERIOD_MS. With -v the first
+ * samples are also fed through appendReading() + extractFeatures() and
+ * every window position where the device window has full length is
+ * compared against the kernel, and against the sketch's SampleStats of the
+ * two window halves combined with merge().
+ *
+ * Input: one sample per line, either "ms,value[,...]" (the snapshot
+ * format) or a bare value in volts. -g seconds generates a synthetic
+ * recording instead. -o writes every s-th window as CSV.
+ *
+ * Compile: g++ -std=gnu++17 -O3 -march=native -pthread -I host host/window_features.cpp -o window_features
+ * Usage:   ./window_features capture.csv|-g seconds [-w window] [-t threads]
+ *                            [-v samples] [-o features.csv] [-s stride]
+ */
+
+#include "../esp32_anomaly_main.cpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#define KERNEL_LANES 16   // contiguous runs of windows advanced together (SIMD lanes)
+#define KERNEL_SPAN 256   // windows per lane per block
+#define KERNEL_BLOCK (KERNEL_LANES * KERNEL_SPAN)
+
+// Features of a block of windows, structure of arrays in [step][lane]
+// order: window i of the block is entry (i % span) * KERNEL_LANES + i / span
+struct FeatureBlock {
+  std::vector<float> mean, std_dev, rms, min_val, max_val, trend;
+  size_t span = 0;
+
+  void resize(size_t n) {
+    mean.resize(n); std_dev.resize(n); rms.resize(n);
+    min_val.resize(n); max_val.resize(n); trend.resize(n);
+  }
+  size_t entry(size_t window) const { return (window % span) * KERNEL_LANES + window / span; }
+};
+
+struct KernelScratch {
+  std::vector<float> y;  // block input, [step][lane]
+  std::vector<float> fwd_min, fwd_max, bwd_min, bwd_max;
+
+  void resize(int window) {
+    size_t n = (size_t)(KERNEL_SPAN + window) * KERNEL_LANES;
+    y.resize(n);
+    fwd_min.resize(n); fwd_max.resize(n); bwd_min.resize(n); bwd_max.resize(n);
+  }
+};
+
+// Compare-and-select: vminps/vmaxps, where fminf/fmaxf are libm calls
+static inline float lesser(float a, float b) { return a < b ? a : b; }
+static inline float greater(float a, float b) { return a > b ? a : b; }
+
+// Features of every lane's run of windows. Each lane keeps running sums
+// relative to shift (float cancellation, as in extractFeatures), with
+// sum_xy regressing on x = 0 .. window-1 inside the window, so one step
+// is a handful of vector operations across the lanes. trendTimeScale()
+// is 1 at even spacing. Arrays are parameters so __restrict is honoured.
+static void slideFeatures(const float* __restrict yt,
+                          const float* __restrict fmin, const float* __restrict fmax,
+                          const float* __restrict bmin, const float* __restrict bmax,
+                          float* __restrict o_mean, float* __restrict o_std,
+                          float* __restrict o_rms, float* __restrict o_min,
+                          float* __restrict o_max, float* __restrict o_trend,
+                          float shift, int window, size_t span) {
+  const int L = KERNEL_LANES;
+  const double w = window;
+  const double sx = w * (w - 1) / 2;
+  const double sx2 = (w - 1) * w * (2 * w - 1) / 6;
+  const double inv_den = 1.0 / (w * sx2 - sx * sx);
+  const double inv_w = 1.0 / w;
+  const size_t far = (size_t)(window - 1) * L;  // the window's newest sample
+
+  double sum[L], sum_sq[L], sum_xy[L];
+  for (int l = 0; l < L; l++) sum[l] = sum_sq[l] = sum_xy[l] = 0;
+  for (int x = 0; x < window; x++) {
+    for (int l = 0; l < L; l++) {
+      double d = yt[x * L + l] - shift;
+      sum[l] += d;
+      sum_sq[l] += d * d;
+      sum_xy[l] += x * d;
+    }
+  }
+
+  for (size_t k = 0; k < span; k++) {
+    const size_t p0 = k * L;
+    for (int l = 0; l < L; l++) {
+      size_t p = p0 + l;
+      double m = sum[l] * inv_w;
+      float variance = (float)(sum_sq[l] * inv_w - m * m);
+      variance = variance > 0 ? variance : 0;
+      float mean = shift + (float)m;
+      o_mean[p] = mean;
+      o_std[p] = mathSqrt(variance, FAST_MATH_FEATURES);
+      o_rms[p] = mathSqrt(variance + mean * mean, FAST_MATH_FEATURES);
+      o_trend[p] = (float)((w * sum_xy[l] - sx * sum[l]) * inv_den);
+      o_min[p] = lesser(bmin[p], fmin[p + far]);
+      o_max[p] = greater(bmax[p], fmax[p + far]);
+
+      // Slide by one: x shifts down for the samples that stay
+      double d_out = yt[p] - shift;
+      double d_in = yt[p + (size_t)window * L] - shift;
+      sum_xy[l] += d_out - sum[l] + (w - 1) * d_in;
+      sum[l] += d_in - d_out;
+      sum_sq[l] += d_in * d_in - d_out * d_out;
+    }
+  }
+}
+
+// Features of the count (<= KERNEL_LANES * KERNEL_SPAN) windows starting at
+// y[0], y[1], ...; y must hold count + window - 1 samples. Each lane slides
+// over its own run of windows, so every step is one vector operation
+// across the lanes and no sum has a serial dependency longer than a run.
+static void slidingFeatures(const float* y, size_t count, int window,
+                            KernelScratch& s, FeatureBlock& out) {
+  const int L = KERNEL_LANES;
+  const size_t n = count + window - 1;
+  const size_t span = (count + L - 1) / L;
+  const size_t steps = span + window;  // one spare step for the last slide
+  out.span = span;
+
+  // Transpose: lane l reads samples l * span + k (the last sample repeats
+  // past the end; those windows are not reported)
+  float* __restrict yt = s.y.data();
+  for (int l = 0; l < L; l++) {
+    const float* src = y + l * span;
+    size_t avail = (l * span < n) ? n - l * span : 0;
+    size_t k = 0;
+    for (; k < steps && k < avail; k++) yt[k * L + l] = src[k];
+    for (; k < steps; k++) yt[k * L + l] = y[n - 1];
+  }
+
+  // Running extremes forward and backward inside blocks of one window
+  float* __restrict fmin = s.fwd_min.data();
+  float* __restrict fmax = s.fwd_max.data();
+  float* __restrict bmin = s.bwd_min.data();
+  float* __restrict bmax = s.bwd_max.data();
+  for (size_t b = 0; b < steps; b += window) {
+    size_t e = (b + window < steps) ? b + window : steps;
+    for (int l = 0; l < L; l++) fmin[b * L + l] = fmax[b * L + l] = yt[b * L + l];
+    for (size_t k = b + 1; k < e; k++) {
+      for (int l = 0; l < L; l++) {
+        fmin[k * L + l] = lesser(fmin[(k - 1) * L + l], yt[k * L + l]);
+        fmax[k * L + l] = greater(fmax[(k - 1) * L + l], yt[k * L + l]);
+      }
+    }
+    for (int l = 0; l < L; l++) bmin[(e - 1) * L + l] = bmax[(e - 1) * L + l] = yt[(e - 1) * L + l];
+    for (size_t k = e - 1; k-- > b;) {
+      for (int l = 0; l < L; l++) {
+        bmin[k * L + l] = lesser(bmin[(k + 1) * L + l], yt[k * L + l]);
+        bmax[k * L + l] = greater(bmax[(k + 1) * L + l], yt[k * L + l]);
+      }
+    }
+  }
+
+  slideFeatures(yt, fmin, fmax, bmin, bmax, out.mean.data(), out.std_dev.data(),
+                out.rms.data(), out.min_val.data(), out.max_val.data(), out.trend.data(),
+                y[0], window, span);
+}
+
+// ============================================================================
+// RECORDING
+// ============================================================================
+
+static bool loadRecording(const char* path, std::vector<float>& volts) {
+  FILE* in = fopen(path, "r");
+  if (!in) {
+    perror(path);
+    return false;
+  }
+  char line[256];
+  double last_ms = -1;
+  while (fgets(line, sizeof(line), in)) {
+    double ms, value;
+    if (sscanf(line, "%lf,%lf", &ms, &value) == 2) {
+      if (ms <= last_ms) continue;  // overlapping snapshot dumps
+      last_ms = ms;
+    } else if (sscanf(line, "%lf", &value) != 1 || strchr(line, ',') != NULL) {
+      continue;
+    }
+    volts.push_back((float)value);
+  }
+  fclose(in);
+  return true;
+}
+
+static uint32_t noise_state = 2024;
+
+static float noise() {
+  noise_state = noise_state * 1664525u + 1013904223u;
+  return ((noise_state >> 8) * (1.0f / 8388608.0f)) - 1.0f;
+}
+
+static void generateRecording(double seconds, std::vector<float>& volts) {
+  size_t n = (size_t)(seconds * 1000 / SAMPLE_PERIOD_MS);
+  volts.resize(n);
+  for (size_t k = 0; k < n; k++) {
+    float t_ms = (float)(k % 12566400) * SAMPLE_PERIOD_MS;  // sin period, kept exact in float
+    float code = 2000 + 15 * sin(t_ms * 0.0005f) + 4 * noise();
+    if (k % 50000 >= 49000) code += 150;  // a step every 500 s
+    volts[k] = code * (3.3f / 4095.0f);
+  }
+}
+
+// ============================================================================
+// CHECK AGAINST THE SKETCH
+// ============================================================================
+
+struct FeatureError {
+  float mean = 0, std_dev = 0, rms = 0, min_val = 0, max_val = 0, trend = 0;
+  float merged_mean = 0, merged_std = 0, merged_min = 0, merged_max = 0, merged_trend = 0;
+  size_t compared = 0, skipped = 0;
+  double sketch_s = 0;  // time inside extractFeatures()
+};
+
+static void worst(float& w, float a, float b) { w = fmaxf(w, fabsf(a - b)); }
+
+static FeatureError verify(const std::vector<float>& volts, const std::vector<float>& filtered,
+                           int window, size_t samples) {
+  FeatureError err;
+  tunables.feature_window = window;
+  flushSensorWindow();
+
+  // The kernel runs on the same aligned blocks as in main()
+  KernelScratch scratch;
+  FeatureBlock block;
+  scratch.resize(window);
+  block.resize(KERNEL_BLOCK);
+  size_t windows = filtered.size() - window + 1;
+  size_t block_first = SIZE_MAX;
+  for (size_t k = 0; k < samples; k++) {
+    appendReading(volts[k], filtered[k], (uint32_t)(k * SAMPLE_PERIOD_MS), 0, false);
+    if (k + 1 < (size_t)window) continue;
+    if (featureWindow() != window) {
+      err.skipped++;  // ADWIN has shortened the device window
+      continue;
+    }
+    auto sketch_start = std::chrono::steady_clock::now();
+    Features_t f = extractFeatures();
+    err.sketch_s += std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                                  sketch_start).count();
+    size_t i = k + 1 - window;
+    if (i / KERNEL_BLOCK * KERNEL_BLOCK != block_first) {
+      block_first = i / KERNEL_BLOCK * KERNEL_BLOCK;
+      size_t count = (windows - block_first < KERNEL_BLOCK) ? windows - block_first : KERNEL_BLOCK;
+      slidingFeatures(&filtered[block_first], count, window, scratch, block);
+    }
+    size_t p = block.entry(i - block_first);
+    worst(err.mean, f.mean, block.mean[p]);
+    worst(err.std_dev, f.std_dev, block.std_dev[p]);
+    worst(err.rms, f.rms, block.rms[p]);
+    worst(err.min_val, f.min_val, block.min_val[p]);
+    worst(err.max_val, f.max_val, block.max_val[p]);
+    worst(err.trend, f.trend, block.trend[p]);
+
+    SampleStats halves = windowStats(0, window / 2);
+    halves.merge(windowStats(window / 2, window));
+    worst(err.merged_mean, f.mean, halves.mean);
+    worst(err.merged_std, f.std_dev, sqrtf(halves.variance()));
+    worst(err.merged_min, f.min_val, halves.min_val);
+    worst(err.merged_max, f.max_val, halves.max_val);
+    worst(err.merged_trend, f.trend, halves.slope() * trendTimeScale(halves.count));
+    err.compared++;
+  }
+  return err;
+}
+
+// ============================================================================
+// DRIVER
+// ============================================================================
+
+// Largest |trend| and std_dev seen by one worker, and where
+struct Extremes {
+  float trend = 0, std_dev = 0;
+  size_t trend_at = 0, std_at = 0;
+  double kernel_s = 0;  // time inside slidingFeatures()
+};
+
+int main(int argc, char** argv) {
+  const char* path = NULL;
+  const char* out_path = NULL;
+  double generate_s = 0;
+  int window = FEATURE_WINDOW;
+  int threads = (int)std::thread::hardware_concurrency();
+  size_t verify_samples = 0, stride = 100;
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 < argc && strcmp(argv[i], "-g") == 0) generate_s = atof(argv[++i]);
+    else if (i + 1 < argc && strcmp(argv[i], "-w") == 0) window = atoi(argv[++i]);
+    else if (i + 1 < argc && strcmp(argv[i], "-t") == 0) threads = atoi(argv[++i]);
+    else if (i + 1 < argc && strcmp(argv[i], "-v") == 0) verify_samples = atol(argv[++i]);
+    else if (i + 1 < argc && strcmp(argv[i], "-o") == 0) out_path = argv[++i];
+    else if (i + 1 < argc && strcmp(argv[i], "-s") == 0) stride = atol(argv[++i]);
+    else path = argv[i];
+  }
+  if ((!path && generate_s <= 0) || window < 2 || threads < 1 || stride < 1) {
+    fprintf(stderr, "Usage: %s capture.csv|-g seconds [-w window] [-t threads] "
+                    "[-v samples] [-o features.csv] [-s stride]\n", argv[0]);
+    return 1;
+  }
+
+  std::vector<float> volts;
+  if (path && !loadRecording(path, volts)) return 1;
+  if (!path) generateRecording(generate_s, volts);
+  if (volts.size() < (size_t)window) {
+    fprintf(stderr, "Need at least %d samples, have %zu\n", window, volts.size());
+    return 1;
+  }
+
+  // The device filter is a recurrence: one sequential pass
+  Serial.echo = false;
+  std::vector<float> filtered(volts.size());
+  sensor_filter.reset();
+  for (size_t k = 0; k < volts.size(); k++) filtered[k] = sensor_filter.apply(volts[k]);
+
+  size_t windows = volts.size() - window + 1;
+  size_t blocks = (windows + KERNEL_BLOCK - 1) / KERNEL_BLOCK;
+  printf("Recording: %zu samples | window %d | %zu window positions | %d threads\n",
+         volts.size(), window, windows, threads);
+
+  FILE* out = NULL;
+  if (out_path) {
+    out = fopen(out_path, "w");
+    if (!out) {
+      perror(out_path);
+      return 1;
+    }
+    fprintf(out, "ms,mean,std_dev,rms,min,max,trend\n");
+  }
+
+  std::vector<Extremes> extremes(threads);
+  std::atomic<size_t> next_block(0);
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([&, t] {
+      KernelScratch scratch;
+      FeatureBlock block;
+      scratch.resize(window);
+      block.resize(KERNEL_BLOCK);
+      Extremes& e = extremes[t];
+      for (size_t b; (b = next_block.fetch_add(1)) < blocks;) {
+        size_t first = b * KERNEL_BLOCK;
+        size_t count = (windows - first < KERNEL_BLOCK) ? windows - first : KERNEL_BLOCK;
+        auto kernel_start = std::chrono::steady_clock::now();
+        slidingFeatures(&filtered[first], count, window, scratch, block);
+        e.kernel_s += std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                                    kernel_start).count();
+        for (size_t k = 0; k < block.span; k++) {
+          for (size_t l = 0; l < KERNEL_LANES; l++) {
+            size_t i = l * block.span + k, p = k * KERNEL_LANES + l;
+            if (i >= count) break;  // later lanes are past the end too
+            if (fabsf(block.trend[p]) > e.trend) { e.trend = fabsf(block.trend[p]); e.trend_at = first + i; }
+            if (block.std_dev[p] > e.std_dev) { e.std_dev = block.std_dev[p]; e.std_at = first + i; }
+          }
+        }
+      }
+    });
+  }
+  for (std::thread& w : workers) w.join();
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  Extremes all;
+  for (const Extremes& e : extremes) {
+    all.kernel_s += e.kernel_s;
+    if (e.trend > all.trend) { all.trend = e.trend; all.trend_at = e.trend_at; }
+    if (e.std_dev > all.std_dev) { all.std_dev = e.std_dev; all.std_at = e.std_at; }
+  }
+  printf("Kernel: %.0f M windows/s per thread | with the scan for extremes: %.0f M windows/s "
+         "in %.3f s\n", windows / all.kernel_s * 1e-6, windows / elapsed * 1e-6, elapsed);
+  // Windows are labelled by their newest sample, as on the device
+  printf("Largest |trend|: %.3e V/period at %.0f ms | largest std_dev: %.2f mV at %.0f ms\n",
+         all.trend, (double)(all.trend_at + window - 1) * SAMPLE_PERIOD_MS,
+         all.std_dev * 1000, (double)(all.std_at + window - 1) * SAMPLE_PERIOD_MS);
+
+  if (out) {
+    KernelScratch scratch;
+    FeatureBlock block;
+    scratch.resize(window);
+    block.resize(KERNEL_BLOCK);
+    for (size_t first = 0; first < windows; first += KERNEL_BLOCK) {
+      size_t count = (windows - first < KERNEL_BLOCK) ? windows - first : KERNEL_BLOCK;
+      slidingFeatures(&filtered[first], count, window, scratch, block);
+      for (size_t i = (stride - first % stride) % stride; i < count; i += stride) {
+        size_t p = block.entry(i);
+        fprintf(out, "%.0f,%.6f,%.6f,%.6f,%.6f,%.6f,%.4e\n",
+                (double)(first + i + window - 1) * SAMPLE_PERIOD_MS, block.mean[p],
+                block.std_dev[p], block.rms[p], block.min_val[p], block.max_val[p],
+                block.trend[p]);
+      }
+    }
+    fclose(out);
+    printf("Wrote every %zu-th window to %s\n", stride, out_path);
+  }
+
+  if (verify_samples > 0) {
+    if (window > BUFFER_SIZE) {
+      printf("Check skipped: window %d exceeds the device buffer (%d)\n", window, BUFFER_SIZE);
+      return 0;
+    }
+    size_t samples = (verify_samples < volts.size()) ? verify_samples : volts.size();
+    FeatureError err = verify(volts, filtered, window, samples);
+    printf("Check vs extractFeatures(): %zu windows (%zu skipped, ADWIN-shortened) | "
+           "%.0f M windows/s there\n", err.compared, err.skipped, err.compared / err.sketch_s * 1e-6);
+    printf("  max |diff|: mean %.2e | std_dev %.2e | rms %.2e | min %.2e | max %.2e | trend %.2e\n",
+           err.mean, err.std_dev, err.rms, err.min_val, err.max_val, err.trend);
+    printf("  merged halves: mean %.2e | std_dev %.2e | min %.2e | max %.2e | trend %.2e\n",
+           err.merged_mean, err.merged_std, err.merged_min, err.merged_max, err.merged_trend);
+  }
+  return 0;
+}
@@ -0,0 +1,117 @@
+/*
+ * MERGEABLE SAMPLE STATISTICS
+ * ESP32 Anomaly Detection System
+ *
+ * Shared by esp32_anomaly_main.cpp and calibration_utility.cpp; keep it
+ * in the sketch folder next to them (Arduino IDE: Sketch -> Add File...).
+ */
+
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+// ============================================================================
+// MERGEABLE STATISTICS: PARTIAL RESULTS
+// ============================================================================
+
+/*
+ * Sample statistics that combine without revisiting samples
+ *
+ * Count, mean, sum of squared deviations (m2), min/max and the x-y
+ * co-moment of a set of (x, y) samples, x being the sample position.
+ * Two sets merge exactly with Chan's pairwise update, in any grouping:
+ *   n = n_a + n_b,  d = mean_b - mean_a
+ *   mean = mean_a + d * n_b / n,  m2 = m2_a + m2_b + d^2 * n_a * n_b / n
+ * with the same update for the x moments and the co-moment, so runs of a
+ * block, shards of a replay, time ranges or devices reduce in O(1) per
+ * merge. Welford's update adds one sample. The least-squares slope over
+ * positions is c_xy / x_m2; keep x relative to a nearby origin in float.
+ *
+ * remove() runs the same updates backwards, which lets a sliding window
+ * take out the samples leaving it. It cannot narrow min/max again, so a
+ * sliding owner has to know when the extremes have left (the feature
+ * window tracks the sequence numbers that set them), and the backward
+ * updates accumulate rounding: rebuild from the samples now and then.
+ */
+
+struct SampleStats {
+  uint32_t count;
+  float mean, m2;
+  float min_val, max_val;
+  float x_mean, x_m2, c_xy;
+
+  void add(float x, float y) {
+    if (count == 0) min_val = max_val = y;
+    min_val = fmin(min_val, y);
+    max_val = fmax(max_val, y);
+    count++;
+    float inv = 1.0f / count;
+    float dx = x - x_mean;
+    float dy = y - mean;
+    x_mean += dx * inv;
+    mean += dy * inv;
+    x_m2 += dx * (x - x_mean);
+    m2 += dy * (y - mean);
+    c_xy += dx * (y - mean);
+  }
+
+  void merge(const SampleStats& other) {
+    if (other.count == 0) return;
+    if (count == 0) {
+      *this = other;
+      return;
+    }
+    float n = (float)count + other.count;
+    float weight = (float)count * other.count / n;
+    float dx = other.x_mean - x_mean;
+    float dy = other.mean - mean;
+    x_m2 += other.x_m2 + dx * dx * weight;
+    m2 += other.m2 + dy * dy * weight;
+    c_xy += other.c_xy + dx * dy * weight;
+    x_mean += dx * other.count / n;
+    mean += dy * other.count / n;
+    min_val = fmin(min_val, other.min_val);
+    max_val = fmax(max_val, other.max_val);
+    count += other.count;
+  }
+
+  void remove(float x, float y) {
+    // Inverse of add(x, y) for a sample that was added
+    if (count <= 1) {
+      *this = SampleStats();
+      return;
+    }
+    count--;
+    float x_prev = x_mean - (x - x_mean) / count;
+    float y_prev = mean - (y - mean) / count;
+    x_m2 -= (x - x_prev) * (x - x_mean);
+    m2 -= (y - y_prev) * (y - mean);
+    c_xy -= (x - x_prev) * (y - mean);
+    x_mean = x_prev;
+    mean = y_prev;
+  }
+
+  void remove(const SampleStats& part) {
+    // Inverse of merge(part) for a subset that was merged or added
+    if (part.count == 0) return;
+    if (part.count >= count) {
+      *this = SampleStats();
+      return;
+    }
+    float n = count;
+    float rest = (float)count - part.count;
+    float weight = rest * part.count / n;
+    float dx = (part.x_mean - x_mean) * n / rest;
+    float dy = (part.mean - mean) * n / rest;
+    x_m2 -= part.x_m2 + dx * dx * weight;
+    m2 -= part.m2 + dy * dy * weight;
+    c_xy -= part.c_xy + dx * dy * weight;
+    x_mean = part.x_mean - dx;
+    mean = part.mean - dy;
+    count -= part.count;
+  }
+
+  float variance() const { return (count && m2 > 0) ? m2 / count : 0; }  // population
+  float slope() const { return (x_m2 > 0) ? c_xy / x_m2 : 0; }
+};